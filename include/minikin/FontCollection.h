@@ -35,6 +35,9 @@ public:
     explicit FontCollection(const std::vector<std::shared_ptr<FontFamily>>& typefaces);
     explicit FontCollection(std::shared_ptr<FontFamily>&& typeface);
 
+    // Removes the layouts done with this collection from the global layout cache.
+    ~FontCollection();
+
     struct Run {
         FakedFont fakedFont;
         int start;
@@ -68,6 +71,13 @@ public:
 
     uint32_t getId() const;
 
+    size_t getFamilyCount() const { return mFamilies.size(); }
+    const std::shared_ptr<FontFamily>& getFamilyAt(size_t index) const { return mFamilies[index]; }
+
+    // Returns an identifier of the fonts in this collection which, unlike getId(), stays the same
+    // across processes as long as the same font files are used in the same order.
+    uint64_t getFingerprint() const;
+
 private:
     static const int kLogCharsPerPage = 8;
     static const int kPageMask = (1 << kLogCharsPerPage) - 1;
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_FONT_FEATURE_SETTINGS_H
+#define MINIKIN_FONT_FEATURE_SETTINGS_H
+
+#include <cstdint>
+#include <string>
+
+namespace minikin {
+
+// The ID of the settings which are not registered because the cache already holds too many. The
+// layouts done with such settings parse them for each word and are not cached.
+constexpr uint32_t kUnregisteredFontFeatureSettingsId = UINT32_MAX;
+
+// Looks up the parsed font feature settings, e.g. "'tnum' on, 'smcp'", from an internal cache and
+// returns its ID. If the settings are not in the cache, parses and registers them, or returns
+// kUnregisteredFontFeatureSettingsId if the cache is full. The ID of the empty settings is always
+// 0.
+uint32_t registerFontFeatureSettings(const std::string& settings);
+
+}  // namespace minikin
+
+#endif  // MINIKIN_FONT_FEATURE_SETTINGS_H
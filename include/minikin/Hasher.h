@@ -18,6 +18,7 @@
 #define MINIKIN_HASHER_H
 
 #include <cstdint>
+#include <cstring>
 
 #include <string>
 
@@ -25,57 +26,99 @@
 
 namespace minikin {
 
-// Provides a Jenkins hash implementation.
+// Provides a 64-bit hash in the style of wyhash. Arrays are consumed 16 bytes at a time, each
+// step being a single 64x64->128 bit multiplication whose halves are folded together, instead of
+// a chain of shifts and additions per 4 bytes. This makes hashing the text of every
+// LayoutCacheKey several times faster on 64-bit CPUs.
+//
+// The hash is deterministic, so it can be stored, e.g. in FontCollection::getFingerprint(), but it
+// depends on the byte order of the machine.
 class Hasher {
 public:
-    Hasher() : mHash(0u) {}
+    Hasher() : mHash(kSeed) {}
 
     IGNORE_INTEGER_OVERFLOW inline Hasher& update(uint32_t data) {
-        mHash += data;
-        mHash += (mHash << 10);
-        mHash ^= (mHash >> 6);
+        mHash = mix(data ^ kSecret0, mHash ^ kSecret1);
         return *this;
     }
 
+    // Hashes the bits of the float, as converting it to an integer would drop the fraction. Both
+    // zeros compare equal, so they hash the same.
+    inline Hasher& updateFloat(float data) {
+        uint32_t bits = 0;
+        if (data != 0.0f) {
+            memcpy(&bits, &data, sizeof(bits));
+        }
+        return update(bits);
+    }
+
     inline Hasher& updateShorts(const uint16_t* data, uint32_t length) {
         update(length);
-        uint32_t i;
-        for (i = 0; i < (length & -2); i += 2) {
-            update((uint32_t)data[i] | ((uint32_t)data[i + 1] << 16));
-        }
-        if (length & 1) {
-            update((uint32_t)data[i]);
-        }
-        return *this;
+        return updateBytes(data, length * sizeof(uint16_t));
     }
 
     inline Hasher& updateString(const std::string& str) {
-        uint32_t size = str.size();
-        update(size);
-        uint32_t i;
-        for (i = 0; i < (size & -4); i += 4) {
-            update((uint32_t)str[i] | ((uint32_t)str[i + 1] << 8) | ((uint32_t)str[i + 2] << 16) |
-                   ((uint32_t)str[i + 3] << 24));
-        }
-        if (size & 3) {
-            uint32_t data = str[i];
-            data |= ((size & 3) > 1) ? ((uint32_t)str[i + 1] << 8) : 0;
-            data |= ((size & 3) > 2) ? ((uint32_t)str[i + 2] << 16) : 0;
-            update(data);
-        }
-        return *this;
+        update(str.size());
+        return updateBytes(str.data(), str.size());
     }
 
-    IGNORE_INTEGER_OVERFLOW inline uint32_t hash() {
-        uint32_t hash = mHash;
-        hash += (hash << 3);
-        hash ^= (hash >> 11);
-        hash += (hash << 15);
-        return hash;
+    // Returns the 32-bit hash used by the hash tables.
+    inline uint32_t hash() {
+        const uint64_t hash = hash64();
+        return static_cast<uint32_t>(hash ^ (hash >> 32));
     }
 
+    IGNORE_INTEGER_OVERFLOW inline uint64_t hash64() { return mix(mHash ^ kSecret2, kSecret3); }
+
 private:
-    uint32_t mHash;
+    static constexpr uint64_t kSeed = 0x243F6A8885A308D3ull;
+    static constexpr uint64_t kSecret0 = 0xA0761D6478BD642Full;
+    static constexpr uint64_t kSecret1 = 0xE7037ED1A0B428DBull;
+    static constexpr uint64_t kSecret2 = 0x8EBC6AF09C88C6E3ull;
+    static constexpr uint64_t kSecret3 = 0x589965CC75374CC3ull;
+
+    // Multiplies the two values and folds the 128-bit product into 64 bits.
+    IGNORE_INTEGER_OVERFLOW static inline uint64_t mix(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+        const __uint128_t r = static_cast<__uint128_t>(a) * b;
+        return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+#else
+        // For 32-bit CPUs.
+        const uint64_t ha = a >> 32, hb = b >> 32, la = static_cast<uint32_t>(a),
+                       lb = static_cast<uint32_t>(b);
+        const uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+        const uint64_t t = rl + (rm0 << 32);
+        uint64_t carry = t < rl;
+        const uint64_t lo = t + (rm1 << 32);
+        carry += lo < t;
+        const uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+        return lo ^ hi;
+#endif
+    }
+
+    static inline uint64_t read64(const uint8_t* p) {
+        uint64_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    // The length must have been hashed before, as the last block is padded with zeros.
+    IGNORE_INTEGER_OVERFLOW inline Hasher& updateBytes(const void* data, size_t size) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        uint64_t hash = mHash;
+        for (; size >= 16; p += 16, size -= 16) {
+            hash = mix(read64(p) ^ kSecret0, read64(p + 8) ^ hash);
+        }
+        if (size > 0) {
+            uint8_t last[16] = {};
+            memcpy(last, p, size);
+            hash = mix(read64(last) ^ kSecret0, read64(last + 8) ^ hash);
+        }
+        mHash = hash;
+        return *this;
+    }
+
+    uint64_t mHash;
 };
 
 }  // namespace minikin
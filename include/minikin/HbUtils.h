@@ -47,10 +47,15 @@ struct HbBufferDeleter {
     void operator()(hb_buffer_t* v) { hb_buffer_destroy(v); }
 };
 
+struct HbShapePlanDeleter {
+    void operator()(hb_shape_plan_t* v) { hb_shape_plan_destroy(v); }
+};
+
 using HbBlobUniquePtr = std::unique_ptr<hb_blob_t, HbBlobDeleter>;
 using HbFaceUniquePtr = std::unique_ptr<hb_face_t, HbFaceDeleter>;
 using HbFontUniquePtr = std::unique_ptr<hb_font_t, HbFontDeleter>;
 using HbBufferUniquePtr = std::unique_ptr<hb_buffer_t, HbBufferDeleter>;
+using HbShapePlanUniquePtr = std::unique_ptr<hb_shape_plan_t, HbShapePlanDeleter>;
 
 }  // namespace minikin
 
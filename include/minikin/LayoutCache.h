@@ -19,12 +19,20 @@
 
 #include "minikin/LayoutCore.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
 #include <mutex>
-
-#include <utils/LruCache.h>
+#include <string>
+#include <vector>
 
 #include "minikin/FontCollection.h"
+#include "minikin/FontFeatureSettings.h"
 #include "minikin/Hasher.h"
+#include "minikin/LayoutPaint.h"
+#include "minikin/Macros.h"
 #include "minikin/MinikinPaint.h"
 
 #ifdef _WIN32
@@ -32,170 +40,483 @@
 #endif
 
 namespace minikin {
+// Pieces at least this long, e.g. URLs or long unspaced runs, are cached in a separate smaller
+// tier, so that a few of them can't evict many words.
 const uint32_t LENGTH_LIMIT_CACHE = 128;
+// Pieces at least this long are never cached.
+const uint32_t LENGTH_LIMIT_LONG_PIECE_CACHE = 2048;
+
+class BufferWriter;
+
 // Layout cache datatypes
 class LayoutCacheKey {
 public:
     LayoutCacheKey(const U16StringPiece& text, const Range& range, const MinikinPaint& paint,
                    bool dir, StartHyphenEdit startHyphen, EndHyphenEdit endHyphen)
+            : LayoutCacheKey(text, range, paint, dir, startHyphen, endHyphen, paint.size,
+                             false /* isLetterSpacingBase */) {}
+
+    // Creates the key of the layout done at the given size instead of the size of the paint. If
+    // isLetterSpacingBase is true, the key is the one of the base layout from which the layouts
+    // of all the letter spacings disabling the same ligatures are derived.
+    LayoutCacheKey(const U16StringPiece& text, const Range& range, const MinikinPaint& paint,
+                   bool dir, StartHyphenEdit startHyphen, EndHyphenEdit endHyphen, float size,
+                   bool isLetterSpacingBase)
             : mChars(text.data()),
               mNchars(text.size()),
               mStart(range.getStart()),
               mCount(range.getLength()),
-              mId(paint.font->getId()),
-              mStyle(paint.fontStyle),
-              mSize(paint.size),
-              mScaleX(paint.scaleX),
-              mSkewX(paint.skewX),
-              mLetterSpacing(paint.letterSpacing),
-              mWordSpacing(paint.wordSpacing),
-              mFontFlags(paint.fontFlags),
-              mLocaleListId(paint.localeListId),
-              mFamilyVariant(paint.familyVariant),
+              mPaintId(registerLayoutPaint(paint, size,
+                                           isLetterSpacingBase
+                                                   ? getBaseLetterSpacing(paint.letterSpacing)
+                                                   : paint.letterSpacing,
+                                           isLetterSpacingBase)),
+              mOwnsPaint(false),
               mStartHyphen(startHyphen),
               mEndHyphen(endHyphen),
               mIsRtl(dir),
+              mTextHash(computeTextHash()),
               mHash(computeHash()) {}
 
-    bool operator==(const LayoutCacheKey& o) const {
-        return mId == o.mId && mStart == o.mStart && mCount == o.mCount && mStyle == o.mStyle &&
-               mSize == o.mSize && mScaleX == o.mScaleX && mSkewX == o.mSkewX &&
-               mLetterSpacing == o.mLetterSpacing && mWordSpacing == o.mWordSpacing &&
-               mFontFlags == o.mFontFlags && mLocaleListId == o.mLocaleListId &&
-               mFamilyVariant == o.mFamilyVariant && mStartHyphen == o.mStartHyphen &&
-               mEndHyphen == o.mEndHyphen && mIsRtl == o.mIsRtl && mNchars == o.mNchars &&
-               !memcmp(mChars, o.mChars, mNchars * sizeof(uint16_t));
+    // Creates the key of a layout read from a snapshot, whose paint was written by writeTo().
+    LayoutCacheKey(const U16StringPiece& text, const Range& range, const LayoutPaint& paint,
+                   bool dir, StartHyphenEdit startHyphen, EndHyphenEdit endHyphen)
+            : mChars(text.data()),
+              mNchars(text.size()),
+              mStart(range.getStart()),
+              mCount(range.getLength()),
+              mPaintId(registerLayoutPaint(paint)),
+              mOwnsPaint(true),
+              mStartHyphen(startHyphen),
+              mEndHyphen(endHyphen),
+              mIsRtl(dir),
+              mTextHash(computeTextHash()),
+              mHash(computeHash()) {}
+
+    // A copy holds its own reference to the paint, so that it can be kept by the cache.
+    LayoutCacheKey(const LayoutCacheKey& o)
+            : mChars(o.mChars),
+              mNchars(o.mNchars),
+              mStart(o.mStart),
+              mCount(o.mCount),
+              mPaintId(o.mPaintId),
+              mOwnsPaint(true),
+              mStartHyphen(o.mStartHyphen),
+              mEndHyphen(o.mEndHyphen),
+              mIsRtl(o.mIsRtl),
+              mTextHash(o.mTextHash),
+              mHash(o.mHash) {
+        acquireLayoutPaint(mPaintId);
     }
 
-    android::hash_t hash() const { return mHash; }
+    LayoutCacheKey& operator=(const LayoutCacheKey& o) {
+        acquireLayoutPaint(o.mPaintId);
+        if (mOwnsPaint) {
+            releaseLayoutPaint(mPaintId);
+        }
+        mChars = o.mChars;
+        mNchars = o.mNchars;
+        mStart = o.mStart;
+        mCount = o.mCount;
+        mPaintId = o.mPaintId;
+        mOwnsPaint = true;
+        mStartHyphen = o.mStartHyphen;
+        mEndHyphen = o.mEndHyphen;
+        mIsRtl = o.mIsRtl;
+        mTextHash = o.mTextHash;
+        mHash = o.mHash;
+        return *this;
+    }
 
-    void copyText() {
-        uint16_t* charsCopy = new uint16_t[mNchars];
-        memcpy(charsCopy, mChars, mNchars * sizeof(uint16_t));
-        mChars = charsCopy;
+    ~LayoutCacheKey() {
+        if (mOwnsPaint) {
+            releaseLayoutPaint(mPaintId);
+        }
     }
-    void freeText() {
-        delete[] mChars;
-        mChars = NULL;
+
+    // Writes the key except for the font collection and the locale list IDs, which are only valid
+    // in this process. The font feature settings are written as a string for the same reason.
+    void writeTo(BufferWriter* writer) const;
+
+    bool operator==(const LayoutCacheKey& o) const {
+        return mPaintId == o.mPaintId && mStart == o.mStart && mCount == o.mCount &&
+               mStartHyphen == o.mStartHyphen && mEndHyphen == o.mEndHyphen && mIsRtl == o.mIsRtl &&
+               mNchars == o.mNchars && !memcmp(mChars, o.mChars, mNchars * sizeof(uint16_t));
     }
 
+    uint32_t hash() const { return mHash; }
+
+    // Hash of the context text only, which is shared by the keys of the same text with
+    // different paints.
+    uint32_t textHash() const { return mTextHash; }
+
+    U16StringPiece text() const { return U16StringPiece(mChars, mNchars); }
+
+    // Makes the key point to another copy of the same text, e.g. one owned by the cache.
+    void setTextStorage(const uint16_t* chars) { mChars = chars; }
+
     uint32_t getMemoryUsage() const { return sizeof(LayoutCacheKey) + sizeof(uint16_t) * mNchars; }
 
+    size_t getRangeLength() const { return mCount; }
+
+    // The paint of the layout, with the size and the letter spacing the layout is done with.
+    const LayoutPaint& getPaint() const { return getLayoutPaint(mPaintId); }
+    float getSize() const { return getPaint().size; }
+    float getLetterSpacing() const { return getPaint().letterSpacing; }
+    bool isLetterSpacingBase() const { return getPaint().isLetterSpacingBase; }
+    uint32_t getFontCollectionId() const { return getPaint().fontCollectionId; }
+    uint32_t getLocaleListId() const { return getPaint().localeListId; }
+
+    // False if the font feature settings of the paint were not registered, in which case the key
+    // doesn't identify the settings and the layout is never cached.
+    bool isCacheable() const {
+        return getPaint().fontFeatureSettingsId != kUnregisteredFontFeatureSettingsId;
+    }
+
 private:
     const uint16_t* mChars;
     size_t mNchars;
     size_t mStart;
     size_t mCount;
-    uint32_t mId;  // for the font collection
-    FontStyle mStyle;
-    float mSize;
-    float mScaleX;
-    float mSkewX;
-    float mLetterSpacing;
-    float mWordSpacing;
-    int32_t mFontFlags;
-    uint32_t mLocaleListId;
-    FamilyVariant mFamilyVariant;
+    // Interned from the fields of MinikinPaint by registerLayoutPaint().
+    uint32_t mPaintId;
+    // False if the ID is borrowed from the thread which created the key for a lookup. Such a key
+    // is only valid until the thread registers another paint.
+    bool mOwnsPaint;
     StartHyphenEdit mStartHyphen;
     EndHyphenEdit mEndHyphen;
     bool mIsRtl;
-    // Note: any fields added to MinikinPaint must also be reflected here.
-    // TODO: language matching (possibly integrate into style)
-    android::hash_t mHash;
+    // Note: any fields added to MinikinPaint must also be reflected in LayoutPaint.
+    uint32_t mTextHash;
+    uint32_t mHash;
+
+    // The base layouts are done with one representative letter spacing of each class of letter
+    // spacings, as the letter spacing only affects shaping by disabling optional ligatures.
+    static float getBaseLetterSpacing(float letterSpacing) {
+        return isLigatureDisabledByLetterSpacing(letterSpacing) ? 1.0f : 0.0f;
+    }
 
-    android::hash_t computeHash() const {
+    uint32_t computeTextHash() const {
+        return Hasher().updateShorts(mChars, mNchars).hash();
+    }
+
+    uint32_t computeHash() const {
         return Hasher()
-                .update(mId)
+                .update(mPaintId)
                 .update(mStart)
                 .update(mCount)
-                .update(mStyle.identifier())
-                .update(mSize)
-                .update(mScaleX)
-                .update(mSkewX)
-                .update(mLetterSpacing)
-                .update(mWordSpacing)
-                .update(mFontFlags)
-                .update(mLocaleListId)
-                .update(static_cast<uint8_t>(mFamilyVariant))
                 .update(packHyphenEdit(mStartHyphen, mEndHyphen))
                 .update(mIsRtl)
-                .updateShorts(mChars, mNchars)
+                .update(mTextHash)
                 .hash();
     }
 };
 
-class LayoutCache : private android::OnEntryRemoved<LayoutCacheKey, LayoutPiece*> {
+class LayoutCache {
 public:
-    void clear() {
-        std::lock_guard<std::mutex> lock(mMutex);
-        mCache.clear();
-    }
+    // The partition used by the paints which don't select another one.
+    static constexpr uint32_t kDefaultPartition = 0;
 
-    // Do not use LayoutCache inside the callback function, otherwise dead-lock may happen.
+    // The maximum number of partitions, including the default partition.
+    static constexpr uint32_t kMaxPartitionCount = 16;
+
+    struct PartitionStats {
+        // Requests served from the cache, including the ones served from the caches of the
+        // threads. A thread adds its thread cache hits on its next lookup of the shared cache.
+        uint64_t hitCount;
+        // Requests which were not found in the cache.
+        uint64_t missCount;
+        // The memory of the cached keys and layout pieces, which is limited by maxSizeInBytes.
+        size_t sizeInBytes;
+        size_t maxSizeInBytes;
+        uint32_t entryCount;
+    };
+
+    ~LayoutCache();
+
+    // Removes all the layouts, including the ones of the pinned partitions.
+    void clear();
+
+    // Removes the layouts done with the given font collection, leaving the layouts of the other
+    // font collections in the cache. Called when a font collection is destroyed.
+    void removeFontCollection(uint32_t fontCollectionId);
+
+    // Returns the layout of the given word, doing the layout only if it is not in the cache yet.
+    // The returned layout is immutable and stays valid after it is evicted from the cache.
+    std::shared_ptr<const LayoutPiece> getOrCreate(const U16StringPiece& text, const Range& range,
+                                                   const MinikinPaint& paint, bool dir,
+                                                   StartHyphenEdit startHyphen,
+                                                   EndHyphenEdit endHyphen);
+
+    // The callback function is called without holding any lock of the cache.
     template <typename F>
     void getOrCreate(const U16StringPiece& text, const Range& range, const MinikinPaint& paint,
                      bool dir, StartHyphenEdit startHyphen, EndHyphenEdit endHyphen, F& f) {
-        LayoutCacheKey key(text, range, paint, dir, startHyphen, endHyphen);
-        if (paint.skipCache() || range.getLength() >= LENGTH_LIMIT_CACHE) {
-            f(LayoutPiece(text, range, dir, paint, startHyphen, endHyphen), paint);
+        getOrCreate(text, range, paint, dir, startHyphen, endHyphen, false /* advancesOnly */, f);
+    }
+
+    // If advancesOnly is true, the callback only uses the advances and the extent of the layout,
+    // e.g. for measuring text, so a layout done with advancesOnly is enough. Such a layout is
+    // cached until a full layout of the same word is requested, which then replaces it.
+    template <typename F>
+    void getOrCreate(const U16StringPiece& text, const Range& range, const MinikinPaint& paint,
+                     bool dir, StartHyphenEdit startHyphen, EndHyphenEdit endHyphen,
+                     bool advancesOnly, F& f) {
+        if (range.getLength() >= LENGTH_LIMIT_LONG_PIECE_CACHE) {
+            f(LayoutPiece(text, range, dir, paint, startHyphen, endHyphen,
+                          false /* keepGlyphInfo */, advancesOnly),
+              paint);
+            return;
+        }
+        const bool sizeIndependent = isSizeIndependent(paint);
+        const bool letterSpacingDerived = isLetterSpacingDerived(paint);
+        Partition& partition = getPartition(paint);
+        LayoutCacheKey key(text, range, paint, dir, startHyphen, endHyphen,
+                           sizeIndependent ? kCanonicalTextSize : paint.size, letterSpacingDerived);
+        if (!key.isCacheable()) {
+            f(LayoutPiece(text, range, dir, paint, kUnregisteredFontFeatureSettingsId, startHyphen,
+                          endHyphen, false /* keepGlyphInfo */, advancesOnly),
+              paint);
+            return;
+        }
+        auto deliver = [&](const LayoutPiece& layout) {
+            if (sizeIndependent || letterSpacingDerived) {
+                f(deriveLayout(layout, key, paint), paint);
+            } else {
+                f(layout, paint);
+            }
+        };
+        uint64_t generation;
+        const LayoutPiece* recent = findInThreadCache(partition, key, &generation);
+        if (recent != nullptr && isUsable(*recent, advancesOnly)) {
+            deliver(*recent);
             return;
         }
         {
-            std::lock_guard<std::mutex> lock(mMutex);
-            LayoutPiece* layout = mCache.get(key);
+            // Cache hits don't take any lock. The found layout is kept alive until the end of
+            // the read section even if it is evicted by another thread in the meantime.
+            ReadSection section;
+            const std::shared_ptr<const LayoutPiece>* layout =
+                    find(partition, key, advancesOnly);
             if (layout != nullptr) {
-                f(*layout, paint);
+                putInThreadCache(partition, key, *layout, generation);
+                deliver(**layout);
                 return;
             }
         }
-        // Doing text layout takes long time, so releases the mutex during doing layout.
-        // Don't care even if we do the same layout in other thred.
-        key.copyText();
-        std::unique_ptr<LayoutPiece> layout =
-                std::make_unique<LayoutPiece>(text, range, dir, paint, startHyphen, endHyphen);
-        f(*layout, paint);
-        {
-            std::lock_guard<std::mutex> lock(mMutex);
-            mCache.put(key, layout.release());
-        }
+        std::shared_ptr<const LayoutPiece> layout = create(
+                partition, key, text, range, paint, dir, startHyphen, endHyphen, advancesOnly);
+        putInThreadCache(partition, key, layout, generation);
+        deliver(*layout);
     }
 
+    // Enables reusing layouts across text sizes for the paints with LinearMetrics_Flag, whose
+    // layouts scale linearly. Such layouts are then done and cached at kCanonicalTextSize only,
+    // and scaled to the size of the paint on every request. Disabled by default.
+    void setSizeIndependentLayoutEnabled(bool enabled) { mSizeIndependentLayoutEnabled = enabled; }
+
+    // Enables deriving the layouts of letter spaced text from a cached base layout of the same
+    // text, so that animating or varying the letter spacing doesn't shape the text again. The
+    // base layouts keep the per glyph information needed for this. Disabled by default.
+    void setLetterSpacingDerivationEnabled(bool enabled) {
+        mLetterSpacingDerivationEnabled = enabled;
+    }
+
+    // Sets the upper bound of the memory used by the cached keys and layout pieces of the default
+    // partition. Entries are evicted in approximate LRU order until the cache fits in the new
+    // budget.
+    void setMaxSizeInBytes(size_t maxSizeInBytes);
+
+    size_t getMaxSizeInBytes() const;
+
+    // Returns the memory currently used by the cached keys and layout pieces of all partitions,
+    // including the unused part of the slabs the entries are allocated from.
+    size_t getSizeInBytes();
+
+    // Creates a partition with its own budget, selected by MinikinPaint::layoutCachePartition, so
+    // that the layouts of one workload, e.g. a large document, don't evict the layouts of another
+    // one. The layouts of a pinned partition are never evicted, and new layouts are not cached
+    // once it is full. If a partition of the same name exists, its budget is updated and its ID
+    // is returned. Returns kDefaultPartition if there are already kMaxPartitionCount partitions.
+    uint32_t createPartition(const std::string& name, size_t maxSizeInBytes, bool pinned = false);
+
+    // Returns the statistics of the given partition, or of the default partition if there is no
+    // such partition.
+    PartitionStats getPartitionStats(uint32_t partitionId);
+
+    // Returns the number of layouts that were not done because another thread was doing the same
+    // layout at the same time.
+    uint64_t getDeduplicatedLayoutCount() const { return mDeduplicatedLayoutCount; }
+
+    // Returns the number of requests which were not found in the cache, in all partitions.
+    uint64_t getMissCount();
+
+    // Returns the number of layouts being done after cache misses by all the threads.
+    uint32_t getActiveLayoutCount() const {
+        return mActiveLayoutCount.load(std::memory_order_relaxed);
+    }
+
+    // Waits until no thread is doing a layout after a cache miss, or until the timeout expires.
+    // Returns true if no layout is in progress.
+    bool waitForActiveLayouts(std::chrono::milliseconds timeout);
+
+    // Writes the cached layouts of the given font collections in all partitions to a file, most
+    // frequently used first, so that another process can start with a warm cache by calling
+    // readSnapshot(). Returns false if the file couldn't be written.
+    bool writeSnapshot(const std::string& path,
+                       const std::vector<std::shared_ptr<FontCollection>>& fontCollections);
+
+    // Loads the layouts written by writeSnapshot() into the default partition until it is full.
+    // Layouts of font collections which are not given, or whose fonts are different from the ones
+    // used for writing the file, are skipped. Returns the number of loaded layouts.
+    size_t readSnapshot(const std::string& path,
+                        const std::vector<std::shared_ptr<FontCollection>>& fontCollections);
+
     static LayoutCache& getInstance() {
-        static LayoutCache cache(kMaxEntries);
-        return cache;
+        // Never destructed, since font collections remove their layouts from it in their
+        // destructors, which may run after the static destructors.
+        static LayoutCache* cache = createInstance();
+        return *cache;
+    }
+
+    // Returns the instance of getInstance(), or nullptr if it was never created, so that a font
+    // collection destroyed before any layout, or during the static destruction, doesn't create it.
+    static LayoutCache* getInstanceIfCreated() {
+        return sInstance.load(std::memory_order_acquire);
     }
 
 protected:
-    LayoutCache(uint32_t maxEntries) : mCache(maxEntries) {
-        mCache.setOnEntryRemovedListener(this);
+    // Each partition of the cache is split into shards, which share the budget left by the long
+    // piece tier and have their own locks for inserting and evicting entries. A key always maps
+    // to the same shard of a partition. The default partition has shardCount shards, and the
+    // budget of maxSizeInBytes. If useAdmissionFilter is true, a new word only replaces a cached
+    // one when it has been requested more often. If useThreadCache is true, each thread also
+    // keeps its most recently used layouts, which stay in use after their eviction from the
+    // shared cache until the next clear().
+    LayoutCache(size_t maxSizeInBytes, uint32_t shardCount = 1, bool useAdmissionFilter = true,
+                bool useThreadCache = false);
+
+    uint32_t getCacheSize();
+
+    // Returns the number of shards of the default partition for the pieces shorter than
+    // LENGTH_LIMIT_CACHE.
+    uint32_t getShardCount() const;
+
+private:
+    class Shard;
+    class Partition;
+
+    // Marks the calling thread as reading the cache without a lock. Entries evicted while any
+    // thread is in a read section are freed only after that thread leaves it.
+    class ReadSection {
+    public:
+        ReadSection();
+        ~ReadSection();
+
+    private:
+        MINIKIN_PREVENT_COPY_ASSIGN_AND_MOVE(ReadSection);
+    };
+
+    // Returns the partition selected by the paint, or the default partition if there is no such
+    // partition.
+    Partition& getPartition(const MinikinPaint& paint) {
+        return getPartition(paint.layoutCachePartition);
     }
+    Partition& getPartition(uint32_t partitionId);
+
+    // Returns the cached layout or nullptr, which is also returned if the cached layout was done
+    // with advancesOnly but the full layout is requested. Must be called in a read section.
+    const std::shared_ptr<const LayoutPiece>* find(Partition& partition, const LayoutCacheKey& key,
+                                                   bool advancesOnly);
 
-    uint32_t getCacheSize() {
-        std::lock_guard<std::mutex> lock(mMutex);
-        return mCache.size();
+    // Returns true if the layout serves a request for the full layout, or only for its advances.
+    static bool isUsable(const LayoutPiece& layout, bool advancesOnly) {
+        return advancesOnly || !layout.isAdvancesOnly();
     }
 
-private:
-    // callback for OnEntryRemoved
-    void operator()(LayoutCacheKey& key, LayoutPiece*& value) {
-        key.freeText();
-        delete value;
+    // Looks up the small cache of the calling thread, which is checked before the shared cache so
+    // that repeated words don't touch any shared state. Returns nullptr if the key is not there.
+    // The returned layout is valid until the next call of putInThreadCache() on this thread.
+    // The current generation is stored in the given pointer for putInThreadCache().
+    const LayoutPiece* findInThreadCache(const Partition& partition, const LayoutCacheKey& key,
+                                         uint64_t* generation);
+
+    // Remembers the layout in the cache of the calling thread. It is dropped if the cache has been
+    // cleared since findInThreadCache() returned the generation.
+    void putInThreadCache(const Partition& partition, const LayoutCacheKey& key,
+                          const std::shared_ptr<const LayoutPiece>& layout, uint64_t generation);
+
+    bool isSizeIndependent(const MinikinPaint& paint) const {
+        return mSizeIndependentLayoutEnabled.load(std::memory_order_relaxed) &&
+               (paint.fontFlags & LinearMetrics_Flag) != 0 && paint.size > 0;
     }
 
-    android::LruCache<LayoutCacheKey, LayoutPiece*> mCache GUARDED_BY(mMutex);
+    bool isLetterSpacingDerived(const MinikinPaint& paint) const {
+        return mLetterSpacingDerivationEnabled.load(std::memory_order_relaxed) &&
+               paint.letterSpacing != 0;
+    }
 
-    // static const size_t kMaxEntries = LruCache<LayoutCacheKey, Layout*>::kUnlimitedCapacity;
+    // Returns the layout of the paint made from the cached layout of the given key, which was done
+    // at another size or is a letter spacing base.
+    static LayoutPiece deriveLayout(const LayoutPiece& layout, const LayoutCacheKey& key,
+                                    const MinikinPaint& paint);
 
-    // TODO: eviction based on memory footprint; for now, we just use a constant
-    // number of strings
-    static const size_t kMaxEntries = 5000;
+    // Does the layout at the size of the key after a cache miss and puts it into the partition,
+    // replacing the cached layout done with advancesOnly if the full layout is requested.
+    std::shared_ptr<const LayoutPiece> create(Partition& partition, LayoutCacheKey& key,
+                                              const U16StringPiece& text, const Range& range,
+                                              const MinikinPaint& paint, bool dir,
+                                              StartHyphenEdit startHyphen, EndHyphenEdit endHyphen,
+                                              bool advancesOnly);
 
-    std::mutex mMutex;
-};
+    // Returns the shards of all the partitions.
+    std::vector<Shard*> getShards();
+
+    static LayoutCache* createInstance();
+
+    // Set once by createInstance().
+    static std::atomic<LayoutCache*> sInstance;
+
+    // Partitions are never removed, so they can be read without any lock. mPartitions[0] is the
+    // default partition.
+    std::atomic<Partition*> mPartitions[kMaxPartitionCount];
+    std::atomic<uint32_t> mPartitionCount;
+    std::mutex mPartitionMutex;
+    const bool mUseAdmissionFilter;
+    std::atomic<uint64_t> mDeduplicatedLayoutCount;
+    std::atomic<uint32_t> mActiveLayoutCount;
+    // The number of threads in waitForActiveLayouts(), so that the layouts only take the mutex to
+    // notify them if there are any.
+    std::atomic<uint32_t> mActiveLayoutWaiterCount;
+    std::mutex mActiveLayoutMutex;
+    // Notified when mActiveLayoutCount drops to 0 while a thread is waiting.
+    std::condition_variable mNoActiveLayoutCv;
+    const bool mUseThreadCache;
+    std::atomic<bool> mSizeIndependentLayoutEnabled;
+    std::atomic<bool> mLetterSpacingDerivationEnabled;
+
+    // Changed by clear() to invalidate the thread caches. Generations are unique among all the
+    // instances, so an entry of a thread cache never matches another instance.
+    std::atomic<uint64_t> mGeneration;
 
-inline android::hash_t hash_type(const LayoutCacheKey& key) {
-    return key.hash();
-}
+    // The default budget roughly corresponds to 5000 entries of typical words.
+    static const size_t kDefaultMaxSizeInBytes = 2 * 1024 * 1024;
+
+    // Number of independently locked partitions used by the global cache. Must be small enough
+    // that each shard still holds a useful number of entries.
+    static const uint32_t kDefaultShardCount = 16;
+
+    // The text size of the cached layouts in the size independent mode. A power of two, so that
+    // scaling to the requested size loses as little precision as possible.
+    static constexpr float kCanonicalTextSize = 1024.0f;
+
+    // The long piece tier gets this fraction of the budget.
+    static const uint32_t kLongPieceBudgetDivisor = 8;
+
+    // Number of shards of the partitions created by createPartition(), which usually hold far
+    // fewer layouts than the default partition.
+    static const uint32_t kPartitionShardCount = 1;
+};
 
 }  // namespace minikin
 #endif  // MINIKIN_LAYOUT_CACHE_H
@@ -17,6 +17,8 @@
 #ifndef MINIKIN_LAYOUT_CORE_H
 #define MINIKIN_LAYOUT_CORE_H
 
+#include <cmath>
+#include <memory>
 #include <vector>
 
 #include <gtest/gtest_prod.h>
@@ -27,6 +29,7 @@
 #include "minikin/MinikinFont.h"
 #include "minikin/MinikinRect.h"
 #include "minikin/Range.h"
+#include "minikin/Span.h"
 #include "minikin/U16StringPiece.h"
 
 namespace minikin {
@@ -41,48 +44,134 @@ struct Point {
     float y;
 };
 
+// Returns true if the optional ligatures are disabled for the given letter spacing.
+// See http://dev.w3.org/csswg/css-text-3/#letter-spacing-property
+inline bool isLigatureDisabledByLetterSpacing(float letterSpacing) {
+    return fabs(letterSpacing) > 0.03;
+}
+
 // Immutable, recycle-able layout result.
 class LayoutPiece {
 public:
+    // If keepGlyphInfo is true, the per glyph result of shaping is kept, so that the layouts of
+    // other letter spacings can be derived by withLetterSpace(). If advancesOnly is true, only
+    // the advances and the extent are computed, which is enough for measuring text, skipping the
+    // glyph bounds and leaving out the glyphs.
     LayoutPiece(const U16StringPiece& textBuf, const Range& range, bool isRtl,
-                const MinikinPaint& paint, StartHyphenEdit startHyphen, EndHyphenEdit endHyphen);
+                const MinikinPaint& paint, StartHyphenEdit startHyphen, EndHyphenEdit endHyphen,
+                bool keepGlyphInfo = false, bool advancesOnly = false);
 
-    // Low level accessors.
-    const std::vector<uint8_t>& fontIndices() const { return mFontIndices; }
-    const std::vector<uint32_t> glyphIds() const { return mGlyphIds; }
-    const std::vector<Point> points() const { return mPoints; }
-    const std::vector<float> advances() const { return mAdvances; }
+    // Same as above with the FontFeatureCache ID of the font feature settings of the paint, e.g.
+    // the one of its LayoutPaint, so that the settings are not looked up for every word.
+    LayoutPiece(const U16StringPiece& textBuf, const Range& range, bool isRtl,
+                const MinikinPaint& paint, uint32_t featureSettingsId, StartHyphenEdit startHyphen,
+                EndHyphenEdit endHyphen, bool keepGlyphInfo, bool advancesOnly);
+
+    // Creates the layout from a previously computed result, e.g. read from a cache snapshot.
+    // fontIndices, glyphIds and points must have the same size.
+    LayoutPiece(Span<const uint8_t> fontIndices, Span<const uint16_t> glyphIds,
+                Span<const Point> points, Span<const float> advances, float advance,
+                const MinikinRect& bounds, const MinikinExtent& extent,
+                Span<const FakedFont> fonts);
+
+    LayoutPiece(const LayoutPiece& o);
+    LayoutPiece(LayoutPiece&& o);
+    LayoutPiece& operator=(const LayoutPiece& o);
+    LayoutPiece& operator=(LayoutPiece&& o);
+
+    // Returns a copy of this layout whose geometry is multiplied by the given ratio, e.g. for
+    // deriving the layout at another text size from one done with linear metrics.
+    LayoutPiece scaled(float ratio) const;
+
+    // Returns the layout with the given letter space in pixels, as if it were done with a paint
+    // whose letter spacing disables the same ligatures as the paint used for this layout. This
+    // layout must have been created with keepGlyphInfo.
+    LayoutPiece withLetterSpace(double letterSpace) const;
+
+    // Low level accessors. The spans point into this layout and are valid while it is alive.
+    Span<const uint8_t> fontIndices() const {
+        return Span<const uint8_t>(fontIndicesData(), mGlyphCount);
+    }
+    Span<const uint16_t> glyphIds() const {
+        return Span<const uint16_t>(glyphIdsData(), mGlyphCount);
+    }
+    Span<const Point> points() const { return Span<const Point>(pointsData(), mGlyphCount); }
+    Span<const float> advances() const { return Span<const float>(advancesData(), mAdvanceCount); }
     float advance() const { return mAdvance; }
     const MinikinRect& bounds() const { return mBounds; }
     const MinikinExtent& extent() const { return mExtent; }
-    const std::vector<FakedFont>& fonts() const { return mFonts; }
+    // True if the layout was done with advancesOnly, in which case it has no glyphs and its
+    // bounds are empty.
+    bool isAdvancesOnly() const { return mAdvancesOnly; }
+    Span<const FakedFont> fonts() const { return Span<const FakedFont>(fontsData(), mFontCount); }
 
     // Helper accessors
-    uint32_t glyphCount() const { return mGlyphIds.size(); }
-    const FakedFont& fontAt(int glyphPos) const { return mFonts[mFontIndices[glyphPos]]; }
-    uint32_t glyphIdAt(int glyphPos) const { return mGlyphIds[glyphPos]; }
-    const Point& pointAt(int glyphPos) const { return mPoints[glyphPos]; }
+    uint32_t glyphCount() const { return mGlyphCount; }
+    const FakedFont& fontAt(int glyphPos) const { return fontsData()[fontIndicesData()[glyphPos]]; }
+    uint32_t glyphIdAt(int glyphPos) const { return glyphIdsData()[glyphPos]; }
+    const Point& pointAt(int glyphPos) const { return pointsData()[glyphPos]; }
 
     uint32_t getMemoryUsage() const {
-        return sizeof(uint8_t) * mFontIndices.size() + sizeof(uint32_t) * mGlyphIds.size() +
-               sizeof(Point) * mPoints.size() + sizeof(float) * mAdvances.size() + sizeof(float) +
-               sizeof(MinikinRect) + sizeof(MinikinExtent);
+        return getDataSize() + sizeof(float) + sizeof(MinikinRect) + sizeof(MinikinExtent) +
+               sizeof(GlyphInfo) * mGlyphInfos.size();
     }
 
 private:
     FRIEND_TEST(LayoutTest, doLayoutWithPrecomputedPiecesTest);
 
-    std::vector<uint8_t> mFontIndices;  // per glyph
-    std::vector<uint32_t> mGlyphIds;    // per glyph
-    std::vector<Point> mPoints;         // per glyph
+    // The result of shaping a glyph, which doesn't depend on the letter spacing.
+    struct GlyphInfo {
+        size_t cluster;  // The index of advances().
+        float xAdvance;
+        Point offset;
+        MinikinRect bounds;  // Relative to the pen position.
+        bool startsScriptRun;
+        bool isLetterSpacingAllowed;  // For the script of the run.
+    };
+
+    LayoutPiece()
+            : mGlyphCount(0), mAdvanceCount(0), mFontCount(0), mAdvance(0), mAdvancesOnly(false) {}
+
+    // Allocates mData for the given counts. The contents are left uninitialized.
+    void allocate(uint32_t glyphCount, uint32_t advanceCount, uint32_t fontCount);
+
+    // Computes the positions, the advances and the bounds from the glyph infos. The advances must
+    // be zero filled. Only the advances are computed for the layouts done with advancesOnly.
+    void placeGlyphs(const std::vector<GlyphInfo>& glyphs, double letterSpace);
+
+    // The arrays are packed into mData in the order of decreasing alignment, so that none of
+    // them needs padding.
+    FakedFont* fontsData() const { return reinterpret_cast<FakedFont*>(mData.get()); }
+    Point* pointsData() const {
+        return reinterpret_cast<Point*>(mData.get() + sizeof(FakedFont) * mFontCount);
+    }
+    float* advancesData() const { return reinterpret_cast<float*>(pointsData() + mGlyphCount); }
+    uint16_t* glyphIdsData() const {
+        return reinterpret_cast<uint16_t*>(advancesData() + mAdvanceCount);
+    }
+    uint8_t* fontIndicesData() const {
+        return reinterpret_cast<uint8_t*>(glyphIdsData() + mGlyphCount);
+    }
+    uint32_t getDataSize() const {
+        return sizeof(FakedFont) * mFontCount + sizeof(Point) * mGlyphCount +
+               sizeof(float) * mAdvanceCount + sizeof(uint16_t) * mGlyphCount +
+               sizeof(uint8_t) * mGlyphCount;
+    }
 
-    std::vector<float> mAdvances;  // per code units
+    // The fonts, and per glyph the points, then the advances per code unit, and per glyph the
+    // glyph IDs and the indices of the fonts. A single allocation instead of a vector for each.
+    std::unique_ptr<uint8_t[]> mData;
+    uint32_t mGlyphCount;
+    uint32_t mAdvanceCount;  // The number of code units.
+    uint32_t mFontCount;
 
     float mAdvance;
     MinikinRect mBounds;
     MinikinExtent mExtent;
+    bool mAdvancesOnly;
 
-    std::vector<FakedFont> mFonts;
+    // Per glyph. Only kept for deriving the layouts of other letter spacings.
+    std::vector<GlyphInfo> mGlyphInfos;
 };
 
 // For gtest output
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_LAYOUT_PAINT_H
+#define MINIKIN_LAYOUT_PAINT_H
+
+#include <cstdint>
+
+#include "minikin/FamilyVariant.h"
+#include "minikin/FontStyle.h"
+#include "minikin/Hasher.h"
+#include "minikin/MinikinPaint.h"
+
+namespace minikin {
+
+// The part of MinikinPaint which affects the layout of a word, as laid out by LayoutCache.
+struct LayoutPaint {
+    uint32_t fontCollectionId;
+    FontStyle style;
+    float size;
+    float scaleX;
+    float skewX;
+    float letterSpacing;
+    float wordSpacing;
+    int32_t fontFlags;
+    uint32_t localeListId;
+    FamilyVariant familyVariant;
+    uint32_t fontFeatureSettingsId;
+    // True for the base layouts from which the layouts of other letter spacings are derived.
+    bool isLetterSpacingBase;
+
+    bool operator==(const LayoutPaint& o) const {
+        return fontCollectionId == o.fontCollectionId && style == o.style && size == o.size &&
+               scaleX == o.scaleX && skewX == o.skewX && letterSpacing == o.letterSpacing &&
+               wordSpacing == o.wordSpacing && fontFlags == o.fontFlags &&
+               localeListId == o.localeListId && familyVariant == o.familyVariant &&
+               fontFeatureSettingsId == o.fontFeatureSettingsId &&
+               isLetterSpacingBase == o.isLetterSpacingBase;
+    }
+
+    uint32_t hash() const {
+        return Hasher()
+                .update(fontCollectionId)
+                .update(style.identifier())
+                .updateFloat(size)
+                .updateFloat(scaleX)
+                .updateFloat(skewX)
+                .updateFloat(letterSpacing)
+                .updateFloat(wordSpacing)
+                .update(fontFlags)
+                .update(localeListId)
+                .update(static_cast<uint8_t>(familyVariant))
+                .update(fontFeatureSettingsId)
+                .update(isLetterSpacingBase)
+                .hash();
+    }
+};
+
+// Interns the layout paint into an ID, which is the same for all the equal layout paints in use.
+// The returned ID holds a reference to the paint, which the caller must release with
+// releaseLayoutPaint(). The ID is reused for another paint once all its references are released.
+uint32_t registerLayoutPaint(const LayoutPaint& paint);
+
+// Interns the layout relevant fields of the paint with the given size and letter spacing. The
+// returned ID is borrowed from the calling thread, which holds a reference to the last paint it
+// registered, so registering the same paint for every word doesn't take any lock. The ID is only
+// valid until the thread registers another paint, unless acquireLayoutPaint() is called for it.
+uint32_t registerLayoutPaint(const MinikinPaint& paint, float size, float letterSpacing,
+                             bool isLetterSpacingBase);
+
+// Adds a reference to the paint of a valid ID.
+void acquireLayoutPaint(uint32_t id);
+
+// Releases a reference to the paint, and the ID if it was the last one.
+void releaseLayoutPaint(uint32_t id);
+
+// Returns the layout paint of a valid ID returned by registerLayoutPaint(). Doesn't take any lock.
+const LayoutPaint& getLayoutPaint(uint32_t id);
+
+}  // namespace minikin
+
+#endif  // MINIKIN_LAYOUT_PAINT_H
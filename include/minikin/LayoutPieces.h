@@ -88,12 +88,22 @@ struct LayoutPieces {
     void getOrCreate(const U16StringPiece& textBuf, const Range& range, const Range& context,
                      const MinikinPaint& paint, bool dir, StartHyphenEdit startEdit,
                      EndHyphenEdit endEdit, uint32_t paintId, F& f) const {
+        getOrCreate(textBuf, range, context, paint, dir, startEdit, endEdit, paintId,
+                    false /* advancesOnly */, f);
+    }
+
+    // If advancesOnly is true, the pieces which are not here are looked up in LayoutCache as
+    // layouts done with advancesOnly. See LayoutCache::getOrCreate().
+    template <typename F>
+    void getOrCreate(const U16StringPiece& textBuf, const Range& range, const Range& context,
+                     const MinikinPaint& paint, bool dir, StartHyphenEdit startEdit,
+                     EndHyphenEdit endEdit, uint32_t paintId, bool advancesOnly, F& f) const {
         const HyphenEdit edit = packHyphenEdit(startEdit, endEdit);
         auto it = offsetMap.find(Key(range, edit, dir, paintId));
         if (it == offsetMap.end()) {
             LayoutCache::getInstance().getOrCreate(textBuf.substr(context),
                                                    range - context.getStart(), paint, dir,
-                                                   startEdit, endEdit, f);
+                                                   startEdit, endEdit, advancesOnly, f);
         } else {
             f(it->second, paint);
         }
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_LAYOUT_PREFETCHER_H
+#define MINIKIN_LAYOUT_PREFETCHER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "minikin/Layout.h"
+#include "minikin/LayoutCache.h"
+#include "minikin/Macros.h"
+#include "minikin/MinikinPaint.h"
+
+namespace minikin {
+
+// Warms LayoutCache with the words of texts which are about to be drawn, e.g. the next page while
+// scrolling, by laying them out on a background thread.
+//
+// The background thread runs at a low priority, and it waits between words while any other thread
+// is doing a layout, so that prefetching doesn't delay the layouts needed right now. It waits a few
+// milliseconds at most for each word, so that prefetching still progresses while other threads
+// keep laying out text.
+class LayoutPrefetcher {
+public:
+    struct Request {
+        Request(std::vector<uint16_t>&& text, const MinikinPaint& paint, Bidi bidiFlags)
+                : text(std::move(text)), paint(paint), bidiFlags(bidiFlags) {}
+
+        std::vector<uint16_t> text;
+        MinikinPaint paint;
+        Bidi bidiFlags;
+    };
+
+    explicit LayoutPrefetcher(LayoutCache* cache);
+
+    // Cancels all the batches and waits for the background thread.
+    ~LayoutPrefetcher();
+
+    // Queues the requests for laying out their words which are not in the cache yet. Batches are
+    // processed in the order they are queued. Returns the ID of the batch for cancel().
+    uint64_t prefetch(std::vector<Request>&& requests);
+
+    // Drops the batch if it is still queued, or stops it after the word being laid out if it is
+    // in progress. The words already laid out stay in the cache.
+    void cancel(uint64_t batchId);
+
+    void cancelAll();
+
+    // Waits until all the queued batches are done or cancelled.
+    void waitUntilIdle();
+
+    static LayoutPrefetcher& getInstance() {
+        // Never destructed, like the global LayoutCache it fills.
+        static LayoutPrefetcher* prefetcher = new LayoutPrefetcher(&LayoutCache::getInstance());
+        return *prefetcher;
+    }
+
+private:
+    struct Batch {
+        uint64_t id;
+        std::vector<Request> requests;
+    };
+
+    void run();
+
+    // Lays out the words of the batch which are not in the cache. Returns early if the batch is
+    // cancelled.
+    void prefetchBatch(const Batch& batch);
+
+    // Waits while other threads are doing layouts, for a bounded time.
+    void yieldToForeground();
+
+    LayoutCache* mCache;
+
+    // Set when the batch in progress is cancelled.
+    std::atomic<bool> mCancelled;
+
+    std::deque<Batch> mQueue GUARDED_BY(mMutex);
+    uint64_t mNextBatchId GUARDED_BY(mMutex);
+    // The ID of the batch in progress, or 0 if there is none.
+    uint64_t mRunningBatchId GUARDED_BY(mMutex);
+    bool mStopped GUARDED_BY(mMutex);
+    // Started by the first prefetch().
+    std::thread mThread GUARDED_BY(mMutex);
+
+    std::mutex mMutex;
+    // Notified when a batch is queued, or when the prefetcher is stopped.
+    std::condition_variable mQueueCv;
+    // Notified when a batch is finished.
+    std::condition_variable mIdleCv;
+
+    MINIKIN_PREVENT_COPY_AND_ASSIGN(LayoutPrefetcher);
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_LAYOUT_PREFETCHER_H
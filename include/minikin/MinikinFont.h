@@ -22,13 +22,13 @@
 #include <vector>
 
 #include "minikin/FontVariation.h"
+#include "minikin/MinikinRect.h"
 
 namespace minikin {
 
 class FontFakery;
 struct MinikinExtent;
 struct MinikinPaint;
-struct MinikinRect;
 
 // An abstraction for platform fonts, allowing Minikin to be used with
 // multiple actual implementations of fonts.
@@ -51,6 +51,15 @@ public:
     virtual void GetBounds(MinikinRect* bounds, uint32_t glyph_id, const MinikinPaint& paint,
                            const FontFakery& fakery) const = 0;
 
+    // Fills outBounds with the bounds of count glyphs. Override if the bounds of several glyphs
+    // can be computed faster together than one by one.
+    virtual void GetBoundsBatch(MinikinRect* outBounds, const uint16_t* glyph_ids, uint32_t count,
+                                const MinikinPaint& paint, const FontFakery& fakery) const {
+        for (uint32_t i = 0; i < count; ++i) {
+            GetBounds(&outBounds[i], glyph_ids[i], paint, fakery);
+        }
+    }
+
     virtual void GetFontExtent(MinikinExtent* extent, const MinikinPaint& paint,
                                const FontFakery& fakery) const = 0;
 
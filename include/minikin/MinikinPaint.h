@@ -45,7 +45,8 @@ enum MinikinFontFlags {
 };
 
 // Possibly move into own .h file?
-// Note: if you add a field here, either add it to LayoutCacheKey or to skipCache()
+// Note: if you add a field here, add it to LayoutPaint, unless the field doesn't affect the layout,
+// like layoutCachePartition.
 struct MinikinPaint {
     MinikinPaint(const std::shared_ptr<FontCollection>& font)
             : size(0),
@@ -57,9 +58,8 @@ struct MinikinPaint {
               localeListId(0),
               familyVariant(FamilyVariant::DEFAULT),
               fontFeatureSettings(),
-              font(font) {}
-
-    bool skipCache() const { return !fontFeatureSettings.empty(); }
+              font(font),
+              layoutCachePartition(0) {}
 
     float size;
     float scaleX;
@@ -72,6 +72,9 @@ struct MinikinPaint {
     FamilyVariant familyVariant;
     std::string fontFeatureSettings;
     std::shared_ptr<FontCollection> font;
+    // The partition of LayoutCache holding the layouts done with this paint, as returned by
+    // LayoutCache::createPartition(). Not compared nor hashed, since it doesn't change the layout.
+    uint32_t layoutCachePartition;
 
     void copyFrom(const MinikinPaint& paint) { *this = paint; }
 
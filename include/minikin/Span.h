@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_SPAN_H
+#define MINIKIN_SPAN_H
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace minikin {
+
+// A view of an array owned by someone else, like U16StringPiece for any element type.
+template <typename T>
+class Span {
+public:
+    typedef T value_type;
+    typedef T* iterator;
+    typedef T* const_iterator;  // For gtest, which prints the types having it as containers.
+
+    Span() : mData(nullptr), mSize(0) {}
+    Span(T* data, uint32_t size) : mData(data), mSize(size) {}
+    Span(const std::vector<typename std::remove_const<T>::type>& v)  // Intentionally not explicit.
+            : mData(v.data()), mSize(static_cast<uint32_t>(v.size())) {}
+
+    Span(const Span&) = default;
+    Span& operator=(const Span&) = default;
+
+    inline T* data() const { return mData; }
+    inline uint32_t size() const { return mSize; }
+    inline bool empty() const { return mSize == 0; }
+
+    // Undefined behavior if pos is out of range.
+    inline T& operator[](uint32_t pos) const { return mData[pos]; }
+
+    inline T* begin() const { return mData; }
+    inline T* end() const { return mData + mSize; }
+
+    // Compares the elements.
+    inline bool operator==(const Span& o) const {
+        return mSize == o.mSize && std::equal(begin(), end(), o.begin());
+    }
+    inline bool operator!=(const Span& o) const { return !(*this == o); }
+
+private:
+    T* mData;
+    uint32_t mSize;
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_SPAN_H
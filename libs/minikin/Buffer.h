@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_BUFFER_H
+#define MINIKIN_BUFFER_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+namespace minikin {
+
+// Writes plain data to a buffer. Every value is aligned to its natural alignment relative to the
+// beginning of the buffer, so that the buffer can be mapped into memory and read in place.
+// A writer created with nullptr only computes the size of the data.
+class BufferWriter {
+public:
+    explicit BufferWriter(void* buffer) : mData(reinterpret_cast<uint8_t*>(buffer)), mPos(0) {}
+
+    template <typename T>
+    void write(const T& data) {
+        static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+        align(alignof(T));
+        if (mData != nullptr) {
+            memcpy(mData + mPos, &data, sizeof(T));
+        }
+        mPos += sizeof(T);
+    }
+
+    // Writes the number of elements followed by the elements.
+    template <typename T>
+    void writeArray(const T* data, uint32_t size) {
+        static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+        write<uint32_t>(size);
+        align(alignof(T));
+        if (mData != nullptr && size != 0) {
+            memcpy(mData + mPos, data, sizeof(T) * size);
+        }
+        mPos += sizeof(T) * size;
+    }
+
+    void writeString(const std::string& str) { writeArray<char>(str.data(), str.size()); }
+
+    size_t size() const { return mPos; }
+
+private:
+    void align(size_t alignment) {
+        const size_t aligned = (mPos + alignment - 1) & ~(alignment - 1);
+        if (mData != nullptr && aligned != mPos) {
+            memset(mData + mPos, 0, aligned - mPos);
+        }
+        mPos = aligned;
+    }
+
+    uint8_t* mData;
+    size_t mPos;
+};
+
+// Reads the data written by BufferWriter. Reading past the end of the buffer doesn't crash but
+// puts the reader into the error state, in which all the reads return zero or empty arrays.
+class BufferReader {
+public:
+    BufferReader(const void* buffer, size_t size)
+            : mData(reinterpret_cast<const uint8_t*>(buffer)),
+              mSize(size),
+              mPos(0),
+              mError(false) {}
+
+    template <typename T>
+    T read() {
+        static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+        T data = {};
+        if (reserve(alignof(T), sizeof(T))) {
+            memcpy(&data, mData + mPos, sizeof(T));
+            mPos += sizeof(T);
+        }
+        return data;
+    }
+
+    // Returns the pointer to the elements in the buffer and stores the number of them to size.
+    template <typename T>
+    const T* readArray(uint32_t* size) {
+        static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+        *size = read<uint32_t>();
+        if (!reserve(alignof(T), static_cast<uint64_t>(sizeof(T)) * *size)) {
+            *size = 0;
+            return nullptr;
+        }
+        const T* data = reinterpret_cast<const T*>(mData + mPos);
+        mPos += sizeof(T) * *size;
+        return data;
+    }
+
+    std::string readString() {
+        uint32_t size;
+        const char* data = readArray<char>(&size);
+        return data == nullptr ? std::string() : std::string(data, size);
+    }
+
+    bool hasError() const { return mError; }
+
+private:
+    // Aligns the position and returns true if length bytes can be read from there.
+    bool reserve(size_t alignment, uint64_t length) {
+        if (mError) {
+            return false;
+        }
+        const size_t aligned = (mPos + alignment - 1) & ~(alignment - 1);
+        if (aligned > mSize || length > mSize - aligned) {
+            mError = true;
+            return false;
+        }
+        mPos = aligned;
+        return true;
+    }
+
+    const uint8_t* mData;
+    size_t mSize;
+    size_t mPos;
+    bool mError;
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_BUFFER_H
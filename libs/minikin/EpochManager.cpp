@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "EpochManager.h"
+
+namespace minikin {
+
+// Gives the record back to the manager when the owner thread exits.
+struct EpochManager::ThreadRecordHolder {
+    ThreadRecordHolder() : mRecord(nullptr) {}
+    ~ThreadRecordHolder() {
+        if (mRecord != nullptr) {
+            mRecord->mState.store(0, std::memory_order_release);
+            mRecord->mInUse.store(false, std::memory_order_release);
+        }
+    }
+
+    ThreadRecord* mRecord;
+};
+
+EpochManager::ThreadRecord* EpochManager::getThreadRecord() {
+    static thread_local ThreadRecordHolder holder;
+    if (holder.mRecord == nullptr) {
+        holder.mRecord = acquireRecord();
+    }
+    return holder.mRecord;
+}
+
+EpochManager::ThreadRecord* EpochManager::acquireRecord() {
+    for (ThreadRecord* record = mRecords.load(std::memory_order_acquire); record != nullptr;
+         record = record->mNext) {
+        bool inUse = false;
+        if (!record->mInUse.load(std::memory_order_relaxed) &&
+            record->mInUse.compare_exchange_strong(inUse, true, std::memory_order_acquire)) {
+            return record;
+        }
+    }
+    ThreadRecord* record = new ThreadRecord();
+    ThreadRecord* head = mRecords.load(std::memory_order_relaxed);
+    do {
+        record->mNext = head;
+    } while (!mRecords.compare_exchange_weak(head, record, std::memory_order_release,
+                                             std::memory_order_relaxed));
+    return record;
+}
+
+void EpochManager::enter() {
+    ThreadRecord* record = getThreadRecord();
+    if (record->mDepth++ != 0) {
+        return;
+    }
+    const uint64_t epoch = mGlobalEpoch.load(std::memory_order_relaxed);
+    record->mState.store((epoch << 1) | 1, std::memory_order_relaxed);
+    // Makes the state visible to writers before any shared pointer is loaded by this reader.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+void EpochManager::exit() {
+    ThreadRecord* record = getThreadRecord();
+    if (--record->mDepth != 0) {
+        return;
+    }
+    record->mState.store(0, std::memory_order_release);
+}
+
+void EpochManager::tryAdvance() {
+    uint64_t epoch = mGlobalEpoch.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (ThreadRecord* record = mRecords.load(std::memory_order_acquire); record != nullptr;
+         record = record->mNext) {
+        const uint64_t state = record->mState.load(std::memory_order_acquire);
+        if ((state & 1) != 0 && (state >> 1) != epoch) {
+            return;  // This reader may still see objects unlinked in an older epoch.
+        }
+    }
+    mGlobalEpoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_release,
+                                         std::memory_order_relaxed);
+}
+
+}  // namespace minikin
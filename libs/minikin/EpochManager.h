@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_EPOCH_MANAGER_H
+#define MINIKIN_EPOCH_MANAGER_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "minikin/Macros.h"
+
+namespace minikin {
+
+// Epoch based reclamation for data structures that are read without holding a lock.
+//
+// A reader calls enter() before loading any shared pointer and exit() after it stops using the
+// pointed objects. A writer unlinks an object so that no new reader can reach it, and then keeps
+// it alive with the value of getEpoch() at that time. The object can be freed once
+// isSafeToFree() returns true for that epoch, which means every reader that might have seen the
+// object has exited.
+//
+// enter() and exit() may be nested, and they never block.
+class EpochManager {
+public:
+    static EpochManager& getInstance() {
+        static EpochManager manager;
+        return manager;
+    }
+
+    void enter();
+    void exit();
+
+    // Returns the epoch to be associated with an object which has just been unlinked.
+    uint64_t getEpoch() const { return mGlobalEpoch.load(std::memory_order_relaxed); }
+
+    // Advances the global epoch if all the readers have observed the current one.
+    void tryAdvance();
+
+    bool isSafeToFree(uint64_t retiredEpoch) const {
+        return retiredEpoch + 2 <= mGlobalEpoch.load(std::memory_order_acquire);
+    }
+
+private:
+    // Per thread state. Records are never freed; a record released by an exited thread is reused
+    // by the next thread.
+    struct ThreadRecord {
+        ThreadRecord() : mState(0), mInUse(true), mDepth(0), mNext(nullptr) {}
+
+        // (epoch << 1) | 1 while the thread is in a read section, 0 otherwise.
+        std::atomic<uint64_t> mState;
+        std::atomic<bool> mInUse;
+        uint32_t mDepth;  // Only accessed by the owner thread.
+        ThreadRecord* mNext;
+    };
+
+    struct ThreadRecordHolder;
+
+    EpochManager() : mGlobalEpoch(1), mRecords(nullptr) {}
+
+    ThreadRecord* getThreadRecord();
+    ThreadRecord* acquireRecord();
+
+    std::atomic<uint64_t> mGlobalEpoch;
+    std::atomic<ThreadRecord*> mRecords;
+
+    MINIKIN_PREVENT_COPY_ASSIGN_AND_MOVE(EpochManager);
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_EPOCH_MANAGER_H
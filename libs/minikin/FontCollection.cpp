@@ -19,11 +19,14 @@
 #include "minikin/FontCollection.h"
 
 #include <algorithm>
+#include <cstring>
 
 #include <log/log.h>
 #include <unicode/unorm2.h>
 
 #include "minikin/Emoji.h"
+#include "minikin/Hasher.h"
+#include "minikin/LayoutCache.h"
 
 #include "Locale.h"
 #include "LocaleListCache.h"
@@ -53,6 +56,13 @@ FontCollection::FontCollection(const vector<std::shared_ptr<FontFamily>>& typefa
     init(typefaces);
 }
 
+FontCollection::~FontCollection() {
+    LayoutCache* cache = LayoutCache::getInstanceIfCreated();
+    if (cache != nullptr) {
+        cache->removeFontCollection(mId);
+    }
+}
+
 void FontCollection::init(const vector<std::shared_ptr<FontFamily>>& typefaces) {
     mId = gNextCollectionId++;
     vector<uint32_t> lastChar;
@@ -517,4 +527,41 @@ uint32_t FontCollection::getId() const {
     return mId;
 }
 
+uint64_t FontCollection::getFingerprint() const {
+    // A 64-bit fingerprint, so that an accidental match of different fonts is practically
+    // impossible.
+    Hasher hasher;
+
+    hasher.update(mFamilies.size());
+    for (const auto& family : mFamilies) {
+        const std::string locales = LocaleListCache::getString(family->localeListId());
+        hasher.updateString(locales);
+        hasher.update(static_cast<uint32_t>(family->variant()));
+        hasher.update(family->isCustomFallback());
+        hasher.update(family->getNumFonts());
+        for (size_t i = 0; i < family->getNumFonts(); ++i) {
+            const Font* font = family->getFont(i);
+            const MinikinFont* typeface = font->typeface().get();
+            hasher.update(font->style().identifier());
+            hasher.update(static_cast<uint32_t>(typeface->GetFontSize()));
+            hasher.update(typeface->GetFontIndex());
+            hasher.update(typeface->GetAxes().size());
+            for (const FontVariation& variation : typeface->GetAxes()) {
+                uint32_t valueBits;
+                memcpy(&valueBits, &variation.value, sizeof(valueBits));
+                hasher.update(variation.axisTag);
+                hasher.update(valueBits);
+            }
+            // The font revision and the checksum of the whole font file in the head table.
+            HbBlob head(font->baseFont(), HB_TAG('h', 'e', 'a', 'd'));
+            if (head && head.size() >= 12) {
+                for (size_t j = 4; j < 12; ++j) {
+                    hasher.update(head.get()[j]);
+                }
+            }
+        }
+    }
+    return hasher.hash64();
+}
+
 }  // namespace minikin
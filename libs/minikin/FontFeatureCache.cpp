@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FontFeatureCache.h"
+
+#include "minikin/FontFeatureSettings.h"
+
+#include "MinikinInternal.h"
+#include "StringPiece.h"
+
+namespace minikin {
+
+const uint32_t FontFeatureCache::kEmptyId;
+const uint32_t FontFeatureCache::kUnregisteredId;
+
+uint32_t registerFontFeatureSettings(const std::string& settings) {
+    return FontFeatureCache::getId(settings);
+}
+
+static std::vector<hb_feature_t> parseFeatures(const std::string& str) {
+    std::vector<hb_feature_t> features;
+    SplitIterator it(str, ',');
+    while (it.hasNext()) {
+        StringPiece featureStr = it.next();
+        hb_feature_t feature;
+        /* We do not allow setting features on ranges.  As such, reject any
+         * setting that has non-universal range. */
+        if (hb_feature_from_string(featureStr.data(), featureStr.size(), &feature) &&
+            feature.start == 0 && feature.end == (unsigned int)-1) {
+            features.push_back(feature);
+        }
+    }
+    return features;
+}
+
+// Disable default-on non-required ligature features if letter-spacing
+// See http://dev.w3.org/csswg/css-text-3/#letter-spacing-property
+// "When the effective spacing between two characters is not zero (due to
+// either justification or a non-zero value of letter-spacing), user agents
+// should not apply optional ligatures."
+static std::vector<hb_feature_t> disableOptionalLigatures(
+        const std::vector<hb_feature_t>& features) {
+    static const hb_feature_t no_liga = {HB_TAG('l', 'i', 'g', 'a'), 0, 0, ~0u};
+    static const hb_feature_t no_clig = {HB_TAG('c', 'l', 'i', 'g'), 0, 0, ~0u};
+    std::vector<hb_feature_t> withoutLigatures = {no_liga, no_clig};
+    withoutLigatures.insert(withoutLigatures.end(), features.begin(), features.end());
+    return withoutLigatures;
+}
+
+// static
+std::vector<hb_feature_t> FontFeatureCache::parse(const std::string& settings,
+                                                  bool disableLigatures) {
+    std::vector<hb_feature_t> features = parseFeatures(settings);
+    return disableLigatures ? disableOptionalLigatures(features) : features;
+}
+
+FontFeatureCache::FontFeatureCache(uint32_t maxSize) : mMaxSize(maxSize) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    // Insert an empty feature list for mapping the settings without any valid feature.
+    addFeatures(std::vector<hb_feature_t>());
+    mFeatureStrings.emplace_back();
+    mLookupTable.insert(std::make_pair("", kEmptyId));
+}
+
+uint32_t FontFeatureCache::getIdInternal(const std::string& settings) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    const auto& it = mLookupTable.find(settings);
+    if (it != mLookupTable.end()) {
+        return it->second;
+    }
+
+    // Given settings are not in cache. Insert them and return newly assigned ID.
+    std::vector<hb_feature_t> features = parseFeatures(settings);
+    if (mLookupTable.size() >= mMaxSize) {
+        // Not registered, so that the cache doesn't grow without bound. The layouts parse the
+        // settings themselves.
+        return features.empty() ? kEmptyId : kUnregisteredId;
+    }
+    const uint32_t id = features.empty() ? kEmptyId : mFeatures.size();
+    if (id != kEmptyId) {
+        addFeatures(std::move(features));
+        mFeatureStrings.push_back(settings);
+    }
+    mLookupTable.insert(std::make_pair(settings, id));
+    return id;
+}
+
+void FontFeatureCache::addFeatures(std::vector<hb_feature_t>&& features) {
+    mFeaturesWithoutLigatures.push_back(disableOptionalLigatures(features));
+    mFeatures.push_back(std::move(features));
+}
+
+const std::vector<hb_feature_t>& FontFeatureCache::getByIdInternal(uint32_t id,
+                                                                   bool disableLigatures) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    MINIKIN_ASSERT(id < mFeatures.size(), "Lookup by unknown font feature settings ID.");
+    return disableLigatures ? mFeaturesWithoutLigatures[id] : mFeatures[id];
+}
+
+std::string FontFeatureCache::getStringInternal(uint32_t id) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    MINIKIN_ASSERT(id < mFeatureStrings.size(), "Lookup by unknown font feature settings ID.");
+    return mFeatureStrings[id];
+}
+
+}  // namespace minikin
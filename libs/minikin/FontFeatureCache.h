@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_FONT_FEATURE_CACHE_H
+#define MINIKIN_FONT_FEATURE_CACHE_H
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <hb.h>
+
+#include "minikin/FontFeatureSettings.h"
+#include "minikin/Macros.h"
+
+namespace minikin {
+
+// Interns font feature settings strings into IDs, so that the settings are parsed only once and
+// can be part of a LayoutCacheKey. The IDs are never freed, so the number of registered settings
+// is bounded. Once the cache is full, new settings get kUnregisteredId, and have to be parsed by
+// parse() wherever they are used.
+class FontFeatureCache {
+public:
+    // The ID of the settings without any valid feature.
+    const static uint32_t kEmptyId = 0;
+
+    // The ID of the settings which didn't fit in the cache.
+    const static uint32_t kUnregisteredId = kUnregisteredFontFeatureSettingsId;
+
+    // Returns the ID for the given font feature settings, or kUnregisteredId if the cache is full.
+    static inline uint32_t getId(const std::string& settings) {
+        if (settings.empty()) {
+            return kEmptyId;
+        }
+        return getInstance().getIdInternal(settings);
+    }
+
+    // Returns the parsed features of a registered ID. The returned reference stays valid for the
+    // process lifetime.
+    static inline const std::vector<hb_feature_t>& getById(uint32_t id) {
+        return getInstance().getByIdInternal(id, false /* disableLigatures */);
+    }
+
+    // Returns the features to shape with, i.e. the parsed ones preceded by the ones disabling the
+    // optional ligatures if disableLigatures is set, as done for letter spacing. Like getById(),
+    // the returned reference stays valid for the process lifetime.
+    static inline const std::vector<hb_feature_t>& getById(uint32_t id, bool disableLigatures) {
+        return getInstance().getByIdInternal(id, disableLigatures);
+    }
+
+    // Returns the string which was passed to getId() when the ID was assigned. Unlike the ID, the
+    // string can be used across processes.
+    static inline std::string getString(uint32_t id) {
+        return getInstance().getStringInternal(id);
+    }
+
+    // Parses the settings as getById() returns them, for the settings with kUnregisteredId.
+    static std::vector<hb_feature_t> parse(const std::string& settings, bool disableLigatures);
+
+protected:
+    // maxSize is the number of settings strings kept, including the empty settings and the ones
+    // without any valid feature.
+    explicit FontFeatureCache(uint32_t maxSize);  // Singleton
+    ~FontFeatureCache() {}
+
+    uint32_t getIdInternal(const std::string& settings);
+    const std::vector<hb_feature_t>& getByIdInternal(uint32_t id, bool disableLigatures);
+    std::string getStringInternal(uint32_t id);
+
+private:
+    static const uint32_t kMaxSize = 1024;
+
+    void addFeatures(std::vector<hb_feature_t>&& features) EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+
+    static FontFeatureCache& getInstance() {
+        static FontFeatureCache instance(kMaxSize);
+        return instance;
+    }
+
+    const uint32_t mMaxSize;
+
+    // A deque, so that the references returned by getById() are not invalidated by insertions.
+    std::deque<std::vector<hb_feature_t>> mFeatures GUARDED_BY(mMutex);
+
+    // mFeatures with the optional ligatures disabled.
+    std::deque<std::vector<hb_feature_t>> mFeaturesWithoutLigatures GUARDED_BY(mMutex);
+
+    // The string representations of mFeatures.
+    std::vector<std::string> mFeatureStrings GUARDED_BY(mMutex);
+
+    // A map from the font feature settings string to the ID.
+    std::unordered_map<std::string, uint32_t> mLookupTable GUARDED_BY(mMutex);
+
+    std::mutex mMutex;
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_FONT_FEATURE_CACHE_H
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FrequencySketch.h"
+
+#include <algorithm>
+
+namespace minikin {
+
+namespace {
+
+// Odd multipliers giving each row an independent multiplicative hash.
+const uint32_t kSeeds[] = {0x9E3779B1u, 0x85EBCA77u, 0xC2B2AE3Du, 0x27D4EB2Fu};
+
+const uint32_t kMinWidthBits = 6;
+const uint32_t kMaxWidthBits = 24;
+
+}  // namespace
+
+FrequencySketch::FrequencySketch(uint32_t expectedEntries) {
+    reset(widthBitsFor(expectedEntries));
+}
+
+uint32_t FrequencySketch::widthBitsFor(uint32_t expectedEntries) {
+    uint32_t widthBits = kMinWidthBits;
+    while ((1u << widthBits) < expectedEntries && widthBits < kMaxWidthBits) {
+        widthBits++;
+    }
+    return widthBits;
+}
+
+void FrequencySketch::reset(uint32_t widthBits) {
+    mWidthBits = widthBits;
+    mSampleSize = 10u << mWidthBits;
+    mAdditions = 0;
+    mCounters.assign(kDepth << mWidthBits, 0);
+}
+
+void FrequencySketch::ensureCapacity(uint32_t expectedEntries) {
+    const uint32_t widthBits = widthBitsFor(expectedEntries);
+    if (widthBits > mWidthBits) {
+        reset(widthBits);
+    }
+}
+
+uint32_t FrequencySketch::indexOf(uint32_t hash, uint32_t row) const {
+    uint32_t x = hash * kSeeds[row];
+    x ^= x >> 15;
+    return (row << mWidthBits) + (x >> (32 - mWidthBits));
+}
+
+void FrequencySketch::increment(uint32_t hash) {
+    // Conservative update: only the smallest counters are incremented, which reduces the over
+    // estimation caused by collisions.
+    const uint32_t current = frequency(hash);
+    if (current == kMaxFrequency) {
+        return;
+    }
+    for (uint32_t row = 0; row < kDepth; ++row) {
+        uint8_t& counter = mCounters[indexOf(hash, row)];
+        if (counter == current) {
+            counter++;
+        }
+    }
+    if (++mAdditions == mSampleSize) {
+        age();
+    }
+}
+
+uint32_t FrequencySketch::frequency(uint32_t hash) const {
+    uint32_t result = kMaxFrequency;
+    for (uint32_t row = 0; row < kDepth; ++row) {
+        result = std::min(result, static_cast<uint32_t>(mCounters[indexOf(hash, row)]));
+    }
+    return result;
+}
+
+void FrequencySketch::age() {
+    for (uint8_t& counter : mCounters) {
+        counter >>= 1;
+    }
+    mAdditions /= 2;
+}
+
+void FrequencySketch::clear() {
+    std::fill(mCounters.begin(), mCounters.end(), 0);
+    mAdditions = 0;
+}
+
+}  // namespace minikin
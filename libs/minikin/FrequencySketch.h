@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_FREQUENCY_SKETCH_H
+#define MINIKIN_FREQUENCY_SKETCH_H
+
+#include <cstdint>
+#include <vector>
+
+namespace minikin {
+
+// Count-min sketch estimating how often a hash has been seen recently, as used by the TinyLFU
+// admission policy. Each counter saturates at kMaxFrequency, and all the counters are halved
+// after a number of increments proportional to the width so that old history fades out.
+//
+// This class is not thread-safe.
+class FrequencySketch {
+public:
+    // expectedEntries is the number of distinct items the owner is expected to hold.
+    explicit FrequencySketch(uint32_t expectedEntries);
+
+    void increment(uint32_t hash);
+
+    // Returns the estimated frequency of the hash, which is never less than the true frequency
+    // since the last aging unless the counter is saturated.
+    uint32_t frequency(uint32_t hash) const;
+
+    void clear();
+
+    // Widens the sketch if it is too small for expectedEntries. The history is lost if the
+    // sketch is widened, but a sketch is never narrowed.
+    void ensureCapacity(uint32_t expectedEntries);
+
+    static constexpr uint32_t kMaxFrequency = 15;
+
+private:
+    static constexpr uint32_t kDepth = 4;
+
+    static uint32_t widthBitsFor(uint32_t expectedEntries);
+
+    void reset(uint32_t widthBits);
+    uint32_t indexOf(uint32_t hash, uint32_t row) const;
+    void age();
+
+    uint32_t mWidthBits;
+    uint32_t mSampleSize;
+    uint32_t mAdditions;
+    std::vector<uint8_t> mCounters;  // kDepth rows of 2^mWidthBits counters.
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_FREQUENCY_SKETCH_H
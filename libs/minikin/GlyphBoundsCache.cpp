@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "GlyphBoundsCache.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "minikin/Hasher.h"
+
+namespace minikin {
+
+std::size_t GlyphBoundsCache::StrikeKeyHasher::operator()(const StrikeKey& key) const {
+    const uintptr_t font = reinterpret_cast<uintptr_t>(key.font);
+    return Hasher()
+            .update(static_cast<uint32_t>(font))
+            .update(static_cast<uint32_t>(static_cast<uint64_t>(font) >> 32))
+            .updateFloat(key.size)
+            .updateFloat(key.scaleX)
+            .updateFloat(key.skewX)
+            .update(key.fontFlags)
+            .update(key.fakeBold)
+            .update(key.fakeItalic)
+            .hash();
+}
+
+GlyphBoundsCache::Strike& GlyphBoundsCache::getStrike(const StrikeKey& key,
+                                                      const std::shared_ptr<MinikinFont>& font) {
+    Strike& strike = mStrikes[key];
+    if (strike.font.expired()) {
+        mGlyphCount -= strike.bounds.size();
+        strike.bounds.clear();
+        strike.font = font;
+    }
+    return strike;
+}
+
+void GlyphBoundsCache::getBounds(const std::shared_ptr<MinikinFont>& font,
+                                 const MinikinPaint& paint, const FontFakery& fakery,
+                                 const uint16_t* glyphIds, uint32_t count,
+                                 MinikinRect* outBounds) {
+    const StrikeKey key(font.get(), paint, fakery);
+    // The positions of the glyphs which are not cached.
+    std::vector<uint32_t> misses;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        const Strike& strike = getStrike(key, font);
+        for (uint32_t i = 0; i < count; ++i) {
+            auto it = strike.bounds.find(glyphIds[i]);
+            if (it == strike.bounds.end()) {
+                misses.push_back(i);
+            } else {
+                outBounds[i] = it->second;
+            }
+        }
+    }
+    if (misses.empty()) {
+        return;
+    }
+
+    // A glyph can appear several times in a run, e.g. the two l's of "hello", but is measured
+    // only once.
+    std::vector<uint16_t> missingIds;
+    missingIds.reserve(misses.size());
+    for (uint32_t i : misses) {
+        missingIds.push_back(glyphIds[i]);
+    }
+    std::sort(missingIds.begin(), missingIds.end());
+    missingIds.erase(std::unique(missingIds.begin(), missingIds.end()), missingIds.end());
+    std::vector<MinikinRect> missingBounds(missingIds.size());
+    font->GetBoundsBatch(missingBounds.data(), missingIds.data(), missingIds.size(), paint,
+                         fakery);
+    for (uint32_t i : misses) {
+        const auto it = std::lower_bound(missingIds.begin(), missingIds.end(), glyphIds[i]);
+        outBounds[i] = missingBounds[it - missingIds.begin()];
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mGlyphCount + missingIds.size() > mMaxGlyphCount) {
+        mStrikes.clear();
+        mGlyphCount = 0;
+    }
+    // Looked up again, as the strike may have been dropped while the lock was released.
+    Strike& strike = getStrike(key, font);
+    for (size_t i = 0; i < missingIds.size(); ++i) {
+        if (strike.bounds.emplace(missingIds[i], missingBounds[i]).second) {
+            mGlyphCount++;
+        }
+    }
+}
+
+}  // namespace minikin
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_GLYPH_BOUNDS_CACHE_H
+#define MINIKIN_GLYPH_BOUNDS_CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "minikin/Font.h"
+#include "minikin/Macros.h"
+#include "minikin/MinikinFont.h"
+#include "minikin/MinikinPaint.h"
+#include "minikin/MinikinRect.h"
+
+namespace minikin {
+
+// Caches the bounds of the glyphs per strike, i.e. per font, size, scaleX, skewX, font flags and
+// fakery, so that the glyphs which appear in many words are measured by the font only once.
+//
+// The glyphs which are not cached are measured with a single MinikinFont::GetBoundsBatch() call
+// made without the lock. When the cache holds more glyphs than its limit, all the strikes are
+// dropped, as the bounds are cheap to recompute compared with tracking their recency.
+class GlyphBoundsCache {
+public:
+    static GlyphBoundsCache& getInstance() {
+        // Never destructed, as layouts may be created by threads still running at exit.
+        static GlyphBoundsCache* instance = new GlyphBoundsCache(kMaxGlyphCount);
+        return *instance;
+    }
+
+    // Fills outBounds with the bounds of count glyphs of the font, as GetBounds() would.
+    void getBounds(const std::shared_ptr<MinikinFont>& font, const MinikinPaint& paint,
+                   const FontFakery& fakery, const uint16_t* glyphIds, uint32_t count,
+                   MinikinRect* outBounds);
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStrikes.clear();
+        mGlyphCount = 0;
+    }
+
+    // Returns the number of glyphs whose bounds are cached.
+    uint32_t getGlyphCount() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mGlyphCount;
+    }
+
+protected:
+    explicit GlyphBoundsCache(uint32_t maxGlyphCount)
+            : mMaxGlyphCount(maxGlyphCount), mGlyphCount(0) {}
+
+private:
+    // 16 bytes per glyph, plus the overhead of the maps.
+    static const uint32_t kMaxGlyphCount = 16 * 1024;
+
+    struct StrikeKey {
+        StrikeKey(const MinikinFont* font, const MinikinPaint& paint, const FontFakery& fakery)
+                : font(font),
+                  size(paint.size),
+                  scaleX(paint.scaleX),
+                  skewX(paint.skewX),
+                  fontFlags(paint.fontFlags),
+                  fakeBold(fakery.isFakeBold()),
+                  fakeItalic(fakery.isFakeItalic()) {}
+
+        bool operator==(const StrikeKey& o) const {
+            return font == o.font && size == o.size && scaleX == o.scaleX && skewX == o.skewX &&
+                   fontFlags == o.fontFlags && fakeBold == o.fakeBold &&
+                   fakeItalic == o.fakeItalic;
+        }
+
+        const MinikinFont* font;
+        float size;
+        float scaleX;
+        float skewX;
+        uint32_t fontFlags;
+        bool fakeBold;
+        bool fakeItalic;
+    };
+
+    struct StrikeKeyHasher {
+        std::size_t operator()(const StrikeKey& key) const;
+    };
+
+    struct Strike {
+        // Tells whether the font at the key's address is still the one measured, as a font
+        // allocated at the address of a destructed one would find its strikes otherwise.
+        std::weak_ptr<MinikinFont> font;
+        std::unordered_map<uint16_t, MinikinRect> bounds;
+    };
+
+    // Returns the strike of the key, emptied if its font has been destructed since.
+    Strike& getStrike(const StrikeKey& key, const std::shared_ptr<MinikinFont>& font)
+            EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+
+    const uint32_t mMaxGlyphCount;
+
+    std::unordered_map<StrikeKey, Strike, StrikeKeyHasher> mStrikes GUARDED_BY(mMutex);
+    uint32_t mGlyphCount GUARDED_BY(mMutex);
+
+    std::mutex mMutex;
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_GLYPH_BOUNDS_CACHE_H
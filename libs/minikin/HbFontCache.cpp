@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "HbFontCache.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "minikin/Hasher.h"
+#include "minikin/MinikinFont.h"
+
+#include "MinikinInternal.h"
+
+namespace minikin {
+
+namespace {
+
+// The arguments of the font functions. The paint is a copy holding only what the MinikinFont
+// reads, and the MinikinFont is shared, as the font outlives the paint and may outlive the Font it
+// was created for.
+struct SkiaArguments {
+    SkiaArguments(const std::shared_ptr<MinikinFont>& font, const MinikinPaint& inPaint,
+                  FontFakery fakery)
+            : font(font), paint(nullptr), fakery(fakery) {
+        paint.size = inPaint.size;
+        paint.scaleX = inPaint.scaleX;
+        paint.skewX = inPaint.skewX;
+        paint.fontFlags = inPaint.fontFlags;
+    }
+
+    const std::shared_ptr<MinikinFont> font;
+    MinikinPaint paint;
+    FontFakery fakery;
+};
+
+static hb_position_t harfbuzzGetGlyphHorizontalAdvance(hb_font_t* /* hbFont */, void* fontData,
+                                                       hb_codepoint_t glyph, void* /* userData */) {
+    SkiaArguments* args = reinterpret_cast<SkiaArguments*>(fontData);
+    float advance = args->font->GetHorizontalAdvance(glyph, args->paint, args->fakery);
+    return 256 * advance + 0.5;
+}
+
+static void harfbuzzGetGlyphHorizontalAdvances(hb_font_t* /* hbFont */, void* fontData,
+                                               unsigned int count,
+                                               const hb_codepoint_t* first_glyph,
+                                               unsigned glyph_stride, hb_position_t* first_advance,
+                                               unsigned advance_stride, void* /* userData */) {
+    SkiaArguments* args = reinterpret_cast<SkiaArguments*>(fontData);
+    std::vector<uint16_t> glyphVec(count);
+    std::vector<float> advVec(count);
+
+    const hb_codepoint_t* glyph = first_glyph;
+    for (uint32_t i = 0; i < count; ++i) {
+        glyphVec[i] = *glyph;
+        glyph = reinterpret_cast<const hb_codepoint_t*>(reinterpret_cast<const uint8_t*>(glyph) +
+                                                        glyph_stride);
+    }
+
+    args->font->GetHorizontalAdvances(glyphVec.data(), count, args->paint, args->fakery,
+                                      advVec.data());
+
+    hb_position_t* advances = first_advance;
+    for (uint32_t i = 0; i < count; ++i) {
+        *advances = HBFloatToFixed(advVec[i]);
+        advances = reinterpret_cast<hb_position_t*>(reinterpret_cast<uint8_t*>(advances) +
+                                                    advance_stride);
+    }
+}
+
+static hb_bool_t harfbuzzGetGlyphHorizontalOrigin(hb_font_t* /* hbFont */, void* /* fontData */,
+                                                  hb_codepoint_t /* glyph */,
+                                                  hb_position_t* /* x */, hb_position_t* /* y */,
+                                                  void* /* userData */) {
+    // Just return true, following the way that Harfbuzz-FreeType implementation does.
+    return true;
+}
+
+hb_font_funcs_t* getFontFuncs() {
+    static hb_font_funcs_t* fontFuncs = nullptr;
+    static std::once_flag once;
+    std::call_once(once, [&]() {
+        fontFuncs = hb_font_funcs_create();
+        // Override the h_advance function since we can't use HarfBuzz's implemenation. It may
+        // return the wrong value if the font uses hinting aggressively.
+        hb_font_funcs_set_glyph_h_advance_func(fontFuncs, harfbuzzGetGlyphHorizontalAdvance, 0, 0);
+        hb_font_funcs_set_glyph_h_advances_func(fontFuncs, harfbuzzGetGlyphHorizontalAdvances, 0,
+                                                0);
+        hb_font_funcs_set_glyph_h_origin_func(fontFuncs, harfbuzzGetGlyphHorizontalOrigin, 0, 0);
+        hb_font_funcs_make_immutable(fontFuncs);
+    });
+    return fontFuncs;
+}
+
+hb_font_funcs_t* getFontFuncsForEmoji() {
+    static hb_font_funcs_t* fontFuncs = nullptr;
+    static std::once_flag once;
+    std::call_once(once, [&]() {
+        fontFuncs = hb_font_funcs_create();
+        // Don't override the h_advance function since we use HarfBuzz's implementation for emoji
+        // for performance reasons.
+        // Note that it is technically possible for a TrueType font to have outline and embedded
+        // bitmap at the same time. We ignore modified advances of hinted outline glyphs in that
+        // case.
+        hb_font_funcs_set_glyph_h_origin_func(fontFuncs, harfbuzzGetGlyphHorizontalOrigin, 0, 0);
+        hb_font_funcs_make_immutable(fontFuncs);
+    });
+    return fontFuncs;
+}
+
+static bool isColorBitmapFont(const HbFontUniquePtr& font) {
+    HbBlob cbdt(font, HB_TAG('C', 'B', 'D', 'T'));
+    return cbdt;
+}
+
+}  // namespace
+
+std::size_t HbFontCache::KeyHasher::operator()(const Key& key) const {
+    const uintptr_t baseFont = reinterpret_cast<uintptr_t>(key.baseFont);
+    return Hasher()
+            .update(static_cast<uint32_t>(baseFont))
+            .update(static_cast<uint32_t>(static_cast<uint64_t>(baseFont) >> 32))
+            .updateFloat(key.size)
+            .updateFloat(key.scaleX)
+            .updateFloat(key.skewX)
+            .update(key.fontFlags)
+            .update(key.fakeBold)
+            .update(key.fakeItalic)
+            .hash();
+}
+
+// static
+HbFontCache::Entry HbFontCache::create(const FakedFont& font, const MinikinPaint& paint) {
+    // We override some functions which are not thread safe.
+    HbFontUniquePtr hbFont(hb_font_create_sub_font(font.font->baseFont().get()));
+    const bool colorBitmapFont = isColorBitmapFont(hbFont);
+    hb_font_set_funcs(hbFont.get(), colorBitmapFont ? getFontFuncsForEmoji() : getFontFuncs(),
+                      new SkiaArguments(font.font->typeface(), paint, font.fakery),
+                      [](void* data) { delete reinterpret_cast<SkiaArguments*>(data); });
+    const double size = paint.size;
+    const double scaleX = paint.scaleX;
+    hb_font_set_ppem(hbFont.get(), size * scaleX, size);
+    hb_font_set_scale(hbFont.get(), HBFloatToFixed(size * scaleX), HBFloatToFixed(size));
+    hb_font_make_immutable(hbFont.get());
+    return {std::move(hbFont), colorBitmapFont, {}};
+}
+
+HbFontUniquePtr HbFontCache::get(const FakedFont& font, const MinikinPaint& paint,
+                                 bool* isColorBitmapFont) {
+    const Key key(font, paint);
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mFonts.find(key);
+        if (it != mFonts.end()) {
+            mLruKeys.splice(mLruKeys.begin(), mLruKeys, it->second.lruPosition);
+            *isColorBitmapFont = it->second.isColorBitmapFont;
+            return HbFontUniquePtr(hb_font_reference(it->second.font.get()));
+        }
+    }
+
+    // Created without the lock, as another thread may get the fonts already cached meanwhile.
+    Entry entry = create(font, paint);
+    *isColorBitmapFont = entry.isColorBitmapFont;
+    HbFontUniquePtr result(hb_font_reference(entry.font.get()));
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mFonts.find(key) != mFonts.end()) {
+        // Another thread created the same font meanwhile. Either of them can be used.
+        return result;
+    }
+    if (mFonts.size() >= mMaxSize) {
+        // The layouts shaping with the dropped font hold references to it.
+        mFonts.erase(mLruKeys.back());
+        mLruKeys.pop_back();
+    }
+    mLruKeys.push_front(key);
+    entry.lruPosition = mLruKeys.begin();
+    mFonts.emplace(key, std::move(entry));
+    return result;
+}
+
+}  // namespace minikin
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_HB_FONT_CACHE_H
+#define MINIKIN_HB_FONT_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include <hb.h>
+
+#include "minikin/Font.h"
+#include "minikin/HbUtils.h"
+#include "minikin/Macros.h"
+#include "minikin/MinikinPaint.h"
+
+namespace minikin {
+
+// Caches the HarfBuzz fonts used for shaping, i.e. sub-fonts of Font::baseFont() whose functions
+// call the MinikinFont, scaled for the size and scaleX of the paint. A layout then doesn't create
+// and set up a font for every word.
+//
+// The fonts are immutable once created, so that threads shape with them concurrently. Each one
+// holds a reference to its base font, whose address is part of the key, so that another font
+// can't be allocated at that address while the entry exists, and to the MinikinFont its functions
+// call. The least recently used font is dropped when the cache is full.
+class HbFontCache {
+public:
+    static HbFontCache& getInstance() {
+        // Never destructed, as layouts may be created by threads still running at exit.
+        static HbFontCache* instance = new HbFontCache(kMaxSize);
+        return *instance;
+    }
+
+    // Returns a new reference to the font for shaping with the paint. Only the size, scaleX,
+    // skewX and font flags of the paint are passed to the MinikinFont. isColorBitmapFont is set
+    // if the font has color bitmap glyphs, whose advances and bounds come from HarfBuzz.
+    HbFontUniquePtr get(const FakedFont& font, const MinikinPaint& paint, bool* isColorBitmapFont);
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFonts.clear();
+        mLruKeys.clear();
+    }
+
+    uint32_t getSize() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mFonts.size();
+    }
+
+protected:
+    explicit HbFontCache(uint32_t maxSize) : mMaxSize(maxSize) {}
+
+private:
+    static const uint32_t kMaxSize = 128;
+
+    struct Key {
+        Key(const FakedFont& font, const MinikinPaint& paint)
+                : baseFont(font.font->baseFont().get()),
+                  size(paint.size),
+                  scaleX(paint.scaleX),
+                  skewX(paint.skewX),
+                  fontFlags(paint.fontFlags),
+                  fakeBold(font.fakery.isFakeBold()),
+                  fakeItalic(font.fakery.isFakeItalic()) {}
+
+        bool operator==(const Key& o) const {
+            return baseFont == o.baseFont && size == o.size && scaleX == o.scaleX &&
+                   skewX == o.skewX && fontFlags == o.fontFlags && fakeBold == o.fakeBold &&
+                   fakeItalic == o.fakeItalic;
+        }
+
+        const hb_font_t* baseFont;
+        float size;
+        float scaleX;
+        float skewX;
+        uint32_t fontFlags;
+        bool fakeBold;
+        bool fakeItalic;
+    };
+
+    struct KeyHasher {
+        std::size_t operator()(const Key& key) const;
+    };
+
+    struct Entry {
+        HbFontUniquePtr font;
+        bool isColorBitmapFont;
+        // The position of the key in mLruKeys.
+        std::list<Key>::iterator lruPosition;
+    };
+
+    static Entry create(const FakedFont& font, const MinikinPaint& paint);
+
+    const uint32_t mMaxSize;
+
+    std::unordered_map<Key, Entry, KeyHasher> mFonts GUARDED_BY(mMutex);
+    // The keys of mFonts, most recently used first.
+    std::list<Key> mLruKeys GUARDED_BY(mMutex);
+
+    std::mutex mMutex;
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_HB_FONT_CACHE_H
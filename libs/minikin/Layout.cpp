@@ -29,7 +29,6 @@
 #include <log/log.h>
 #include <unicode/ubidi.h>
 #include <unicode/utf16.h>
-#include <utils/LruCache.h>
 
 #include "minikin/Emoji.h"
 #include "minikin/HbUtils.h"
@@ -38,10 +37,13 @@
 #include "minikin/Macros.h"
 
 #include "BidiUtils.h"
+#include "GlyphBoundsCache.h"
+#include "HbFontCache.h"
 #include "LayoutSplitter.h"
 #include "LayoutUtils.h"
 #include "LocaleListCache.h"
 #include "MinikinInternal.h"
+#include "ShapePlanCache.h"
 
 namespace minikin {
 
@@ -109,7 +111,7 @@ public:
             mLayout->appendLayout(layoutPiece, mOutOffset, mWordSpacing);
         }
         if (mAdvances) {
-            const std::vector<float>& advances = layoutPiece.advances();
+            const Span<const float> advances = layoutPiece.advances();
             std::copy(advances.begin(), advances.end(), mAdvances);
         }
         if (mTotalAdvance) {
@@ -135,7 +137,9 @@ float Layout::doLayoutWord(const uint16_t* buf, size_t start, size_t count, size
     const U16StringPiece textBuf(buf, bufSize);
     const Range range(start, start + count);
     LayoutAppendFunctor f(layout, advances, &totalAdvance, bufStart, wordSpacing);
-    LayoutCache::getInstance().getOrCreate(textBuf, range, paint, isRtl, startHyphen, endHyphen, f);
+    // Measuring text only needs the advances.
+    LayoutCache::getInstance().getOrCreate(textBuf, range, paint, isRtl, startHyphen, endHyphen,
+                                           layout == nullptr /* advancesOnly */, f);
 
     if (wordSpacing != 0) {
         totalAdvance += wordSpacing;
@@ -151,7 +155,7 @@ void Layout::appendLayout(const LayoutPiece& src, size_t start, float extraAdvan
         mGlyphs.emplace_back(src.fontAt(i), src.glyphIdAt(i), mAdvance + src.pointAt(i).x,
                              src.pointAt(i).y);
     }
-    const std::vector<float>& advances = src.advances();
+    const Span<const float> advances = src.advances();
     for (size_t i = 0; i < advances.size(); i++) {
         mAdvances[i + start] = advances[i];
         if (i == 0) {
@@ -166,6 +170,9 @@ void Layout::appendLayout(const LayoutPiece& src, size_t start, float extraAdvan
 
 void Layout::purgeCaches() {
     LayoutCache::getInstance().clear();
+    GlyphBoundsCache::getInstance().clear();
+    HbFontCache::getInstance().clear();
+    ShapePlanCache::getInstance().clear();
 }
 
 }  // namespace minikin
@@ -0,0 +1,1394 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Minikin"
+
+#include "minikin/LayoutCache.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <unordered_map>
+
+#include <log/log.h>
+
+#include "Buffer.h"
+#include "EpochManager.h"
+#include "FontFeatureCache.h"
+#include "FrequencySketch.h"
+#include "LocaleListCache.h"
+#include "SlabAllocator.h"
+#include "TextPool.h"
+
+namespace minikin {
+
+namespace {
+
+size_t getEntrySizeInBytes(const LayoutCacheKey& key, const LayoutPiece& layout) {
+    return key.getMemoryUsage() + layout.getMemoryUsage();
+}
+
+// Rough memory usage of a cached word, used for sizing the frequency sketch.
+const size_t kEstimatedEntrySizeInBytes = 256;
+
+uint32_t estimateEntryCount(size_t maxSizeInBytes) {
+    return std::min<size_t>(maxSizeInBytes / kEstimatedEntrySizeInBytes, UINT32_MAX);
+}
+
+// A layout which is being done by one thread. Other threads requesting the same key wait for
+// mDone with the shard mutex instead of doing the same layout.
+struct PendingLayout {
+    explicit PendingLayout(bool advancesOnly) : mAdvancesOnly(advancesOnly), mDone(false) {}
+
+    std::condition_variable mCv;
+    // The layout is done with advancesOnly, so it doesn't serve the requests for full layouts.
+    const bool mAdvancesOnly;
+    bool mDone;
+    std::shared_ptr<const LayoutPiece> mLayout;
+};
+
+// Number of the entries of the direct mapped cache of each thread. Must be a power of two.
+const uint32_t kThreadCacheSize = 64;
+
+// The source of LayoutCache::mGeneration. 0 is never used, so that an empty entry of a thread
+// cache never matches.
+std::atomic<uint64_t> gNextGeneration(1);
+
+// The number of cached entries of the font collections in all the instances, counted per bucket
+// of collection IDs. Destroying a font collection whose bucket is empty doesn't lock any shard.
+const uint32_t kCollectionEntryCountBuckets = 1024;
+std::atomic<uint32_t> gCollectionEntryCounts[kCollectionEntryCountBuckets];
+
+// The entries are counted under the lock of their shard. The entries of a font collection are
+// always put before its destruction, since the caller holds a reference to it.
+std::atomic<uint32_t>& getCollectionEntryCount(uint32_t fontCollectionId) {
+    return gCollectionEntryCounts[fontCollectionId % kCollectionEntryCountBuckets];
+}
+
+struct ThreadCacheEntry {
+    ThreadCacheEntry() : generation(0), partitionId(0) {}
+
+    uint64_t generation;
+    uint32_t partitionId;
+    // The storage of the text of the key.
+    std::vector<uint16_t> text;
+    std::optional<LayoutCacheKey> key;
+    std::shared_ptr<const LayoutPiece> layout;
+};
+
+thread_local ThreadCacheEntry tThreadCache[kThreadCacheSize];
+
+ThreadCacheEntry& getThreadCacheEntry(const LayoutCacheKey& key) {
+    return tThreadCache[key.hash() & (kThreadCacheSize - 1)];
+}
+
+// The hits of the thread cache of a thread which are not counted in the statistics of the
+// partitions yet. They are added on the next lookup of the shared cache by the same thread, so
+// that hitting the thread cache doesn't write to memory shared with other threads.
+struct PendingHitCounts {
+    PendingHitCounts() : cache(nullptr), counts() {}
+
+    const LayoutCache* cache;
+    uint32_t counts[LayoutCache::kMaxPartitionCount];
+};
+
+thread_local PendingHitCounts tPendingHits;
+
+// Returns the pending hits of the calling thread in the given partition and resets them.
+uint32_t takePendingHits(const LayoutCache* cache, uint32_t partitionId) {
+    PendingHitCounts& pending = tPendingHits;
+    if (pending.cache != cache) {
+        return 0;
+    }
+    const uint32_t count = pending.counts[partitionId];
+    pending.counts[partitionId] = 0;
+    return count;
+}
+
+struct KeyHasher {
+    std::size_t operator()(const LayoutCacheKey& key) const { return key.hash(); }
+};
+
+// "MLCS" in the native byte order. A snapshot written on a machine with a different byte order
+// is rejected by this.
+const uint32_t kSnapshotMagic = 0x4D4C4353;
+
+// Must be incremented whenever the format of the snapshot changes.
+const uint32_t kSnapshotVersion = 3;
+
+// Identifies a font by its position in the font collection.
+struct SnapshotFont {
+    uint32_t familyIndex;
+    uint32_t fontIndex;
+    uint8_t fakeBold;
+    uint8_t fakeItalic;
+};
+
+struct SnapshotEntry {
+    const LayoutCacheKey* key;
+    const LayoutPiece* layout;
+    uint32_t frequency;
+};
+
+// A read only memory mapping of a whole file.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) : mData(nullptr), mSize(0) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                mData = data;
+                mSize = st.st_size;
+            }
+        }
+        close(fd);
+    }
+
+    ~MappedFile() {
+        if (mData != nullptr) {
+            munmap(mData, mSize);
+        }
+    }
+
+    const void* data() const { return mData; }
+    size_t size() const { return mSize; }
+
+private:
+    void* mData;
+    size_t mSize;
+
+    MINIKIN_PREVENT_COPY_AND_ASSIGN(MappedFile);
+};
+
+void writeLayoutPiece(BufferWriter* writer, const LayoutPiece& layout,
+                      const std::vector<SnapshotFont>& fonts) {
+    writer->writeArray(fonts.data(), fonts.size());
+    writer->writeArray(layout.fontIndices().data(), layout.fontIndices().size());
+    writer->writeArray(layout.glyphIds().data(), layout.glyphIds().size());
+    writer->writeArray(layout.points().data(), layout.points().size());
+    writer->writeArray(layout.advances().data(), layout.advances().size());
+    writer->write(layout.advance());
+    writer->write(layout.bounds());
+    writer->write(layout.extent());
+}
+
+// Returns nullptr if the layout doesn't match the font collection or doesn't have one advance for
+// each character of its range, e.g. the file is corrupted.
+std::shared_ptr<const LayoutPiece> readLayoutPiece(BufferReader* reader,
+                                                   const FontCollection* collection,
+                                                   uint32_t rangeLength) {
+    uint32_t fontCount, glyphCount, pointCount, advanceCount, fontIndexCount;
+    const SnapshotFont* snapshotFonts = reader->readArray<SnapshotFont>(&fontCount);
+    const uint8_t* fontIndices = reader->readArray<uint8_t>(&fontIndexCount);
+    const uint16_t* glyphIds = reader->readArray<uint16_t>(&glyphCount);
+    const Point* points = reader->readArray<Point>(&pointCount);
+    const float* advances = reader->readArray<float>(&advanceCount);
+    const float advance = reader->read<float>();
+    const MinikinRect bounds = reader->read<MinikinRect>();
+    const MinikinExtent extent = reader->read<MinikinExtent>();
+    if (collection == nullptr || reader->hasError() || fontIndexCount != glyphCount ||
+        pointCount != glyphCount || advanceCount != rangeLength) {
+        return nullptr;
+    }
+
+    std::vector<FakedFont> fonts;
+    fonts.reserve(fontCount);
+    for (uint32_t i = 0; i < fontCount; ++i) {
+        const SnapshotFont& font = snapshotFonts[i];
+        if (font.familyIndex >= collection->getFamilyCount()) {
+            return nullptr;
+        }
+        const FontFamily& family = *collection->getFamilyAt(font.familyIndex);
+        if (font.fontIndex >= family.getNumFonts()) {
+            return nullptr;
+        }
+        fonts.push_back(FakedFont{family.getFont(font.fontIndex),
+                                  FontFakery(font.fakeBold, font.fakeItalic)});
+    }
+    for (uint32_t i = 0; i < fontIndexCount; ++i) {
+        if (fontIndices[i] >= fontCount) {
+            return nullptr;
+        }
+    }
+    return std::make_shared<LayoutPiece>(
+            Span<const uint8_t>(fontIndices, fontIndexCount),
+            Span<const uint16_t>(glyphIds, glyphCount), Span<const Point>(points, pointCount),
+            Span<const float>(advances, advanceCount), advance, bounds, extent, fonts);
+}
+
+// The fields written by LayoutCacheKey::writeTo(). They are read before the key is created, so
+// that the paints and the font features of the rejected entries are never interned.
+struct SnapshotKey {
+    explicit SnapshotKey(BufferReader* reader) {
+        chars = reader->readArray<uint16_t>(&nchars);
+        start = reader->read<uint32_t>();
+        count = reader->read<uint32_t>();
+        const uint16_t weight = reader->read<uint16_t>();
+        paint.style = FontStyle(weight, static_cast<FontStyle::Slant>(reader->read<uint8_t>()));
+        paint.size = reader->read<float>();
+        paint.scaleX = reader->read<float>();
+        paint.skewX = reader->read<float>();
+        paint.letterSpacing = reader->read<float>();
+        paint.wordSpacing = reader->read<float>();
+        paint.fontFlags = reader->read<int32_t>();
+        paint.familyVariant = static_cast<FamilyVariant>(reader->read<uint8_t>());
+        fontFeatureSettings = reader->readString();
+        // Base layouts are never written, since the snapshot doesn't have their glyph information.
+        paint.isLetterSpacingBase = false;
+        startHyphen = static_cast<StartHyphenEdit>(reader->read<uint8_t>());
+        endHyphen = static_cast<EndHyphenEdit>(reader->read<uint8_t>());
+        isRtl = reader->read<uint8_t>();
+    }
+
+    bool isValidRange() const { return start <= nchars && count <= nchars - start; }
+
+    LayoutCacheKey toKey(uint32_t fontCollectionId, uint32_t localeListId) {
+        paint.fontCollectionId = fontCollectionId;
+        paint.localeListId = localeListId;
+        paint.fontFeatureSettingsId = FontFeatureCache::getId(fontFeatureSettings);
+        return LayoutCacheKey(U16StringPiece(chars, nchars), Range(start, start + count), paint,
+                              isRtl, startHyphen, endHyphen);
+    }
+
+    // Points into the buffer of the reader.
+    const uint16_t* chars;
+    uint32_t nchars;
+    uint32_t start;
+    uint32_t count;
+    LayoutPaint paint;
+    std::string fontFeatureSettings;
+    StartHyphenEdit startHyphen;
+    EndHyphenEdit endHyphen;
+    bool isRtl;
+};
+
+}  // namespace
+
+void LayoutCacheKey::writeTo(BufferWriter* writer) const {
+    const LayoutPaint& paint = getPaint();
+    writer->writeArray(mChars, mNchars);
+    writer->write<uint32_t>(mStart);
+    writer->write<uint32_t>(mCount);
+    writer->write<uint16_t>(paint.style.weight());
+    writer->write<uint8_t>(static_cast<uint8_t>(paint.style.slant()));
+    writer->write<float>(paint.size);
+    writer->write<float>(paint.scaleX);
+    writer->write<float>(paint.skewX);
+    writer->write<float>(paint.letterSpacing);
+    writer->write<float>(paint.wordSpacing);
+    writer->write<int32_t>(paint.fontFlags);
+    writer->write<uint8_t>(static_cast<uint8_t>(paint.familyVariant));
+    writer->writeString(FontFeatureCache::getString(paint.fontFeatureSettingsId));
+    writer->write<uint8_t>(static_cast<uint8_t>(mStartHyphen));
+    writer->write<uint8_t>(static_cast<uint8_t>(mEndHyphen));
+    writer->write<uint8_t>(mIsRtl);
+}
+
+// A shard is an open addressing hash table which is read without any lock. Inserting and
+// evicting entries are done with mMutex held, and the removed entries and tables are freed once no
+// reader can see them any more. See EpochManager for the details.
+//
+// Instead of the strict LRU order, which requires every hit to relink a list, entries are evicted
+// by the CLOCK algorithm: a hit only sets the reference bit of the entry, and the eviction hand
+// gives a second chance to the entries whose bit is set.
+//
+// On top of that, new entries go through the TinyLFU admission filter: when the shard is full, a
+// new word is only cached if it has been requested more often than the entry the CLOCK hand
+// would evict. The frequencies are estimated by a sketch which counts the misses and, each time
+// the hand clears a reference bit, the hits. This keeps a scan of unique words from flushing the
+// words every screen uses, while readers still do nothing but set the reference bit.
+//
+// Entries are allocated from a slab owned by the shard, and the texts of the keys are interned in
+// a pool, so that the same text laid out with different paints is stored only once. Keys are
+// routed to the shards by the text for that reason.
+//
+// The entries of each font collection are also linked in a list, so that they can be removed
+// without scanning the table when the font collection goes away.
+class LayoutCache::Shard {
+public:
+    // The entries of a pinned shard are never evicted. New entries are not put when it is full.
+    Shard(size_t maxSizeInBytes, bool useAdmissionFilter, bool pinned);
+    ~Shard();
+
+    // Must be called in a read section.
+    const std::shared_ptr<const LayoutPiece>* find(const LayoutCacheKey& key);
+
+    // The text of the key is copied into the text pool, so the key may point to a temporary
+    // buffer. A full layout replaces the cached layout of the key done with advancesOnly.
+    void put(LayoutCacheKey& key, const std::shared_ptr<const LayoutPiece>& layout)
+            EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+
+    // Records a request for the key which was not in the cache.
+    void recordMiss(const LayoutCacheKey& key) EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+
+    void setMaxSizeInBytes(size_t maxSizeInBytes) EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+
+    // Evicts entries until the shard fits in its budget.
+    void trimToSize() EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+
+    void clear() EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+
+    // Removes the entries of the given font collection.
+    void removeFontCollection(uint32_t fontCollectionId) EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+
+    // Appends the cached entries with their frequencies. The entries stay valid until the caller
+    // leaves the current read section.
+    void collectEntries(std::vector<SnapshotEntry>* out) EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+
+    // Returns mSizeInBytes plus the memory of the entry slab which is not used by the cached
+    // entries, i.e. the free blocks and the removed entries which are not freed yet.
+    size_t getMemoryUsage() const EXCLUSIVE_LOCKS_REQUIRED(mMutex) {
+        return mSizeInBytes + mEntryAllocator.getReservedSizeInBytes() -
+               mCount * mEntryAllocator.getBlockSize();
+    }
+
+    // Puts a layout read from a snapshot and restores its frequency, unless the shard is full.
+    bool load(LayoutCacheKey& key, const std::shared_ptr<const LayoutPiece>& layout,
+              uint32_t frequency) EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+
+    // The keys in this map point to the text of the thread doing the layout, which outlives the
+    // map entry.
+    std::unordered_map<LayoutCacheKey, std::shared_ptr<PendingLayout>, KeyHasher> mPendingLayouts
+            GUARDED_BY(mMutex);
+    size_t mMaxSizeInBytes GUARDED_BY(mMutex);
+    size_t mSizeInBytes GUARDED_BY(mMutex);
+    uint32_t mCount GUARDED_BY(mMutex);
+    uint64_t mMissCount GUARDED_BY(mMutex);
+    // Counted without the lock, since most hits don't take it.
+    std::atomic<uint64_t> mHitCount;
+    std::mutex mMutex;
+
+private:
+    struct Entry {
+        Entry(const LayoutCacheKey& key, const std::shared_ptr<const LayoutPiece>& layout)
+                : key(key),
+                  layout(layout),
+                  sizeInBytes(getEntrySizeInBytes(key, *layout)),
+                  referenced(false),
+                  prevInCollection(nullptr),
+                  nextInCollection(nullptr) {}
+
+        LayoutCacheKey key;
+        const std::shared_ptr<const LayoutPiece> layout;
+        const size_t sizeInBytes;
+        // Set by readers on a hit, cleared by the eviction hand. A new entry starts cleared so
+        // that words which are never seen again are evicted first.
+        std::atomic<bool> referenced;
+        // The list of the entries of the same font collection. Only accessed with mMutex held.
+        Entry* prevInCollection;
+        Entry* nextInCollection;
+    };
+
+    // Linear probing table whose capacity is a power of two. Removed entries are replaced by
+    // a tombstone so that probing continues past them.
+    struct Table {
+        explicit Table(uint32_t capacityBits)
+                : shift(32 - capacityBits),
+                  mask((1u << capacityBits) - 1),
+                  slots(new std::atomic<Entry*>[1u << capacityBits]) {
+            for (uint32_t i = 0; i <= mask; ++i) {
+                slots[i].store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        // Fibonacci hashing, so that the bits used for selecting the shard don't bias the slot.
+        uint32_t startIndex(uint32_t hash) const { return (hash * 0x9E3779B9u) >> shift; }
+        uint32_t capacity() const { return mask + 1; }
+
+        const uint32_t shift;
+        const uint32_t mask;
+        std::unique_ptr<std::atomic<Entry*>[]> slots;
+    };
+
+    static Entry* tombstone() { return reinterpret_cast<Entry*>(static_cast<uintptr_t>(1)); }
+    static bool isLive(const Entry* entry) { return entry != nullptr && entry != tombstone(); }
+
+    static Entry* lookup(const Table& table, const LayoutCacheKey& key);
+
+    // Returns the index of the slot holding the given entry, which must be in the table.
+    static uint32_t findSlot(const Table& table, const Entry* entry);
+
+    // Moves the CLOCK hand to the next entry to be evicted and returns it. The shard must not be
+    // empty.
+    Entry* selectVictim() EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+    bool admit(const LayoutCacheKey& key) EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+    void evictOne() EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+    // Replaces the entry in the given slot with a tombstone and retires it.
+    void remove(uint32_t slotIndex, Entry* entry) EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+    void linkToCollection(Entry* entry) EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+    void unlinkFromCollection(Entry* entry) EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+    void rehash(uint32_t capacityBits) EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+    void reclaim() EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+    // Also frees the entries removed just now if no reader is in the cache, so that their memory
+    // is given back right after the shard is emptied.
+    void reclaimNow() EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+    void freeEntry(Entry* entry) EXCLUSIVE_LOCKS_REQUIRED(mMutex);
+
+    static const uint32_t kMinCapacityBits = 4;
+
+    std::atomic<Table*> mTable;
+    uint32_t mTombstoneCount GUARDED_BY(mMutex);
+    uint32_t mClockHand GUARDED_BY(mMutex);
+    const bool mUseAdmissionFilter;
+    const bool mPinned;
+    FrequencySketch mSketch GUARDED_BY(mMutex);
+    SlabAllocator mEntryAllocator GUARDED_BY(mMutex);
+    TextPool mTextPool GUARDED_BY(mMutex);
+    // The first entry of the list of each font collection.
+    std::unordered_map<uint32_t, Entry*> mCollectionEntries GUARDED_BY(mMutex);
+
+    // Unlinked objects and the epoch when they were unlinked, in unlinking order.
+    std::vector<std::pair<uint64_t, Entry*>> mRetiredEntries GUARDED_BY(mMutex);
+    std::vector<std::pair<uint64_t, Table*>> mRetiredTables GUARDED_BY(mMutex);
+};
+
+LayoutCache::Shard::Shard(size_t maxSizeInBytes, bool useAdmissionFilter, bool pinned)
+        : mMaxSizeInBytes(maxSizeInBytes),
+          mSizeInBytes(0),
+          mCount(0),
+          mMissCount(0),
+          mHitCount(0),
+          mTable(new Table(kMinCapacityBits)),
+          mTombstoneCount(0),
+          mClockHand(0),
+          mUseAdmissionFilter(useAdmissionFilter),
+          mPinned(pinned),
+          mSketch(estimateEntryCount(maxSizeInBytes)),
+          mEntryAllocator(sizeof(Entry)) {}
+
+LayoutCache::Shard::~Shard() {
+    // No reader can be in the cache while it is being destructed.
+    Table* table = mTable.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < table->capacity(); ++i) {
+        Entry* entry = table->slots[i].load(std::memory_order_relaxed);
+        if (isLive(entry)) {
+            getCollectionEntryCount(entry->key.getFontCollectionId())
+                    .fetch_sub(1, std::memory_order_relaxed);
+            freeEntry(entry);
+        }
+    }
+    delete table;
+    for (const auto& retired : mRetiredEntries) {
+        freeEntry(retired.second);
+    }
+    for (const auto& retired : mRetiredTables) {
+        delete retired.second;
+    }
+}
+
+LayoutCache::Shard::Entry* LayoutCache::Shard::lookup(const Table& table,
+                                                      const LayoutCacheKey& key) {
+    const uint32_t hash = key.hash();
+    for (uint32_t i = table.startIndex(hash);; i = (i + 1) & table.mask) {
+        Entry* entry = table.slots[i].load(std::memory_order_acquire);
+        if (entry == nullptr) {
+            return nullptr;
+        }
+        if (entry != tombstone() && entry->key.hash() == hash && entry->key == key) {
+            return entry;
+        }
+    }
+}
+
+uint32_t LayoutCache::Shard::findSlot(const Table& table, const Entry* entry) {
+    uint32_t i = table.startIndex(entry->key.hash());
+    while (table.slots[i].load(std::memory_order_relaxed) != entry) {
+        i = (i + 1) & table.mask;
+    }
+    return i;
+}
+
+const std::shared_ptr<const LayoutPiece>* LayoutCache::Shard::find(const LayoutCacheKey& key) {
+    Entry* entry = lookup(*mTable.load(std::memory_order_acquire), key);
+    if (entry == nullptr) {
+        return nullptr;
+    }
+    // Avoid writing to the shared cache line if the bit is already set.
+    if (!entry->referenced.load(std::memory_order_relaxed)) {
+        entry->referenced.store(true, std::memory_order_relaxed);
+    }
+    return &entry->layout;
+}
+
+void LayoutCache::Shard::put(LayoutCacheKey& key,
+                             const std::shared_ptr<const LayoutPiece>& layout) {
+    Table* table = mTable.load(std::memory_order_relaxed);
+    const size_t sizeInBytes = getEntrySizeInBytes(key, *layout);
+    Entry* cached = lookup(*table, key);
+    if (cached != nullptr) {
+        if (!cached->layout->isAdvancesOnly() || layout->isAdvancesOnly()) {
+            // Another thread has already put the same layout while we were doing layout.
+            return;
+        }
+        // The word is already admitted, so only a pinned shard may refuse the bigger layout.
+        if (mPinned && mSizeInBytes - cached->sizeInBytes + sizeInBytes > mMaxSizeInBytes) {
+            return;
+        }
+        remove(findSlot(*table, cached), cached);
+    } else if (mSizeInBytes + sizeInBytes > mMaxSizeInBytes && (mPinned || !admit(key))) {
+        return;
+    }
+    // Keep at least half of the slots empty so that probing stays short and always terminates.
+    if ((mCount + mTombstoneCount + 1) * 2 > table->capacity()) {
+        uint32_t capacityBits = kMinCapacityBits;
+        while ((1u << capacityBits) < (mCount + 1) * 4) {
+            capacityBits++;
+        }
+        rehash(capacityBits);
+        table = mTable.load(std::memory_order_relaxed);
+    }
+
+    Entry* entry = new (mEntryAllocator.allocate()) Entry(key, layout);
+    entry->key.setTextStorage(mTextPool.intern(key.text(), key.textHash()));
+    linkToCollection(entry);
+    for (uint32_t i = table->startIndex(key.hash());; i = (i + 1) & table->mask) {
+        Entry* slot = table->slots[i].load(std::memory_order_relaxed);
+        if (!isLive(slot)) {
+            if (slot == tombstone()) {
+                mTombstoneCount--;
+            }
+            table->slots[i].store(entry, std::memory_order_release);
+            break;
+        }
+    }
+    mCount++;
+    mSizeInBytes += entry->sizeInBytes;
+    trimToSize();
+    reclaim();
+}
+
+void LayoutCache::Shard::recordMiss(const LayoutCacheKey& key) {
+    mMissCount++;
+    mSketch.increment(key.hash());
+}
+
+void LayoutCache::Shard::setMaxSizeInBytes(size_t maxSizeInBytes) {
+    mMaxSizeInBytes = maxSizeInBytes;
+    mSketch.ensureCapacity(estimateEntryCount(maxSizeInBytes));
+    trimToSize();
+    reclaimNow();
+}
+
+void LayoutCache::Shard::trimToSize() {
+    if (mPinned) {
+        return;
+    }
+    while (mSizeInBytes > mMaxSizeInBytes && mCount > 0) {
+        evictOne();
+    }
+}
+
+LayoutCache::Shard::Entry* LayoutCache::Shard::selectVictim() {
+    Table* table = mTable.load(std::memory_order_relaxed);
+    for (;; mClockHand = (mClockHand + 1) & table->mask) {
+        Entry* entry = table->slots[mClockHand].load(std::memory_order_relaxed);
+        if (!isLive(entry)) {
+            continue;
+        }
+        if (!entry->referenced.load(std::memory_order_relaxed)) {
+            return entry;
+        }
+        // Second chance. The entry has been hit since the hand passed it last time.
+        entry->referenced.store(false, std::memory_order_relaxed);
+        mSketch.increment(entry->key.hash());
+    }
+}
+
+bool LayoutCache::Shard::admit(const LayoutCacheKey& key) {
+    if (!mUseAdmissionFilter || mCount == 0) {
+        return true;
+    }
+    // On a tie, the cached word wins, so a word seen only once never replaces anything.
+    return mSketch.frequency(key.hash()) > mSketch.frequency(selectVictim()->key.hash());
+}
+
+void LayoutCache::Shard::evictOne() {
+    Entry* entry = selectVictim();
+    remove(mClockHand, entry);
+    mClockHand = (mClockHand + 1) & mTable.load(std::memory_order_relaxed)->mask;
+}
+
+void LayoutCache::Shard::remove(uint32_t slotIndex, Entry* entry) {
+    mTable.load(std::memory_order_relaxed)->slots[slotIndex].store(tombstone(),
+                                                                    std::memory_order_release);
+    unlinkFromCollection(entry);
+    mTombstoneCount++;
+    mCount--;
+    mSizeInBytes -= entry->sizeInBytes;
+    mRetiredEntries.emplace_back(EpochManager::getInstance().getEpoch(), entry);
+}
+
+void LayoutCache::Shard::linkToCollection(Entry* entry) {
+    getCollectionEntryCount(entry->key.getFontCollectionId())
+            .fetch_add(1, std::memory_order_relaxed);
+    Entry*& head = mCollectionEntries[entry->key.getFontCollectionId()];
+    entry->nextInCollection = head;
+    if (head != nullptr) {
+        head->prevInCollection = entry;
+    }
+    head = entry;
+}
+
+void LayoutCache::Shard::unlinkFromCollection(Entry* entry) {
+    getCollectionEntryCount(entry->key.getFontCollectionId())
+            .fetch_sub(1, std::memory_order_relaxed);
+    if (entry->nextInCollection != nullptr) {
+        entry->nextInCollection->prevInCollection = entry->prevInCollection;
+    }
+    if (entry->prevInCollection != nullptr) {
+        entry->prevInCollection->nextInCollection = entry->nextInCollection;
+    } else if (entry->nextInCollection != nullptr) {
+        mCollectionEntries[entry->key.getFontCollectionId()] = entry->nextInCollection;
+    } else {
+        mCollectionEntries.erase(entry->key.getFontCollectionId());
+    }
+    entry->prevInCollection = nullptr;
+    entry->nextInCollection = nullptr;
+}
+
+void LayoutCache::Shard::removeFontCollection(uint32_t fontCollectionId) {
+    auto it = mCollectionEntries.find(fontCollectionId);
+    if (it == mCollectionEntries.end()) {
+        return;
+    }
+    const Table& table = *mTable.load(std::memory_order_relaxed);
+    Entry* entry = it->second;
+    while (entry != nullptr) {
+        Entry* next = entry->nextInCollection;
+        remove(findSlot(table, entry), entry);
+        entry = next;
+    }
+    reclaimNow();
+}
+
+void LayoutCache::Shard::rehash(uint32_t capacityBits) {
+    Table* oldTable = mTable.load(std::memory_order_relaxed);
+    Table* newTable = new Table(capacityBits);
+    for (uint32_t i = 0; i < oldTable->capacity(); ++i) {
+        Entry* entry = oldTable->slots[i].load(std::memory_order_relaxed);
+        if (!isLive(entry)) {
+            continue;
+        }
+        uint32_t j = newTable->startIndex(entry->key.hash());
+        while (newTable->slots[j].load(std::memory_order_relaxed) != nullptr) {
+            j = (j + 1) & newTable->mask;
+        }
+        newTable->slots[j].store(entry, std::memory_order_relaxed);
+    }
+    mTable.store(newTable, std::memory_order_release);
+    mRetiredTables.emplace_back(EpochManager::getInstance().getEpoch(), oldTable);
+    mTombstoneCount = 0;
+    mClockHand = 0;
+}
+
+void LayoutCache::Shard::clear() {
+    Table* oldTable = mTable.load(std::memory_order_relaxed);
+    mTable.store(new Table(kMinCapacityBits), std::memory_order_release);
+    const uint64_t epoch = EpochManager::getInstance().getEpoch();
+    for (uint32_t i = 0; i < oldTable->capacity(); ++i) {
+        Entry* entry = oldTable->slots[i].load(std::memory_order_relaxed);
+        if (isLive(entry)) {
+            getCollectionEntryCount(entry->key.getFontCollectionId())
+                    .fetch_sub(1, std::memory_order_relaxed);
+            mRetiredEntries.emplace_back(epoch, entry);
+        }
+    }
+    mRetiredTables.emplace_back(epoch, oldTable);
+    mCollectionEntries.clear();
+    mSizeInBytes = 0;
+    mCount = 0;
+    mTombstoneCount = 0;
+    mClockHand = 0;
+    mSketch.clear();
+    reclaimNow();
+}
+
+void LayoutCache::Shard::collectEntries(std::vector<SnapshotEntry>* out) {
+    Table* table = mTable.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < table->capacity(); ++i) {
+        Entry* entry = table->slots[i].load(std::memory_order_relaxed);
+        if (isLive(entry)) {
+            const uint32_t frequency = mSketch.frequency(entry->key.hash());
+            out->push_back({&entry->key, entry->layout.get(), frequency});
+        }
+    }
+}
+
+bool LayoutCache::Shard::load(LayoutCacheKey& key, const std::shared_ptr<const LayoutPiece>& layout,
+                              uint32_t frequency) {
+    if (lookup(*mTable.load(std::memory_order_relaxed), key) != nullptr ||
+        mSizeInBytes + getEntrySizeInBytes(key, *layout) > mMaxSizeInBytes) {
+        return false;
+    }
+    for (uint32_t i = 0; i < frequency && i < FrequencySketch::kMaxFrequency; ++i) {
+        mSketch.increment(key.hash());
+    }
+    put(key, layout);
+    return true;
+}
+
+void LayoutCache::Shard::reclaim() {
+    EpochManager& epochManager = EpochManager::getInstance();
+    epochManager.tryAdvance();
+
+    auto entryIt = mRetiredEntries.begin();
+    for (; entryIt != mRetiredEntries.end() && epochManager.isSafeToFree(entryIt->first);
+         ++entryIt) {
+        freeEntry(entryIt->second);
+    }
+    mRetiredEntries.erase(mRetiredEntries.begin(), entryIt);
+
+    auto tableIt = mRetiredTables.begin();
+    for (; tableIt != mRetiredTables.end() && epochManager.isSafeToFree(tableIt->first);
+         ++tableIt) {
+        delete tableIt->second;
+    }
+    mRetiredTables.erase(mRetiredTables.begin(), tableIt);
+}
+
+void LayoutCache::Shard::reclaimNow() {
+    // An object retired in the current epoch is safe to free two epochs later.
+    EpochManager::getInstance().tryAdvance();
+    reclaim();
+}
+
+void LayoutCache::Shard::freeEntry(Entry* entry) {
+    mTextPool.release(entry->key.text().data());
+    entry->~Entry();
+    mEntryAllocator.free(entry);
+}
+
+LayoutCache::ReadSection::ReadSection() {
+    EpochManager::getInstance().enter();
+}
+
+LayoutCache::ReadSection::~ReadSection() {
+    EpochManager::getInstance().exit();
+}
+
+// A part of the cache with its own budget. The keys are routed to the shards by their text, so
+// that the keys of the same text share one pooled copy of it.
+class LayoutCache::Partition {
+public:
+    Partition(uint32_t id, const std::string& name, size_t maxSizeInBytes, uint32_t shardCount,
+              bool useAdmissionFilter, bool pinned);
+
+    Shard& getShard(const LayoutCacheKey& key) {
+        if (key.getRangeLength() >= LENGTH_LIMIT_CACHE) {
+            return *mShards.back();
+        }
+        return *mShards[key.textHash() % getShardCount()];
+    }
+
+    // Returns the number of shards for the pieces shorter than LENGTH_LIMIT_CACHE.
+    uint32_t getShardCount() const { return mShards.size() - 1; }
+
+    size_t getMaxSizeInBytes() const { return mMaxSizeInBytes; }
+    void setMaxSizeInBytes(size_t maxSizeInBytes);
+
+    const uint32_t mId;
+    const std::string mName;
+    // The last shard is the long piece tier, which holds the pieces of LENGTH_LIMIT_CACHE
+    // characters or longer.
+    std::vector<std::unique_ptr<Shard>> mShards;
+
+private:
+    // Returns the share of the given shard in the budget of the whole partition.
+    static size_t getShardMaxSizeInBytes(size_t maxSizeInBytes, uint32_t shardIndex,
+                                         uint32_t shardCount);
+
+    std::atomic<size_t> mMaxSizeInBytes;
+};
+
+LayoutCache::Partition::Partition(uint32_t id, const std::string& name, size_t maxSizeInBytes,
+                                  uint32_t shardCount, bool useAdmissionFilter, bool pinned)
+        : mId(id), mName(name), mMaxSizeInBytes(maxSizeInBytes) {
+    mShards.reserve(shardCount + 1);
+    for (uint32_t i = 0; i <= shardCount; ++i) {
+        mShards.push_back(std::make_unique<Shard>(
+                getShardMaxSizeInBytes(maxSizeInBytes, i, shardCount), useAdmissionFilter,
+                pinned));
+    }
+}
+
+void LayoutCache::Partition::setMaxSizeInBytes(size_t maxSizeInBytes) {
+    mMaxSizeInBytes = maxSizeInBytes;
+    for (uint32_t i = 0; i < mShards.size(); ++i) {
+        std::lock_guard<std::mutex> lock(mShards[i]->mMutex);
+        mShards[i]->setMaxSizeInBytes(getShardMaxSizeInBytes(maxSizeInBytes, i, getShardCount()));
+    }
+}
+
+size_t LayoutCache::Partition::getShardMaxSizeInBytes(size_t maxSizeInBytes, uint32_t shardIndex,
+                                                      uint32_t shardCount) {
+    const size_t longPieceSize = maxSizeInBytes / kLongPieceBudgetDivisor;
+    if (shardIndex == shardCount) {
+        return longPieceSize;
+    }
+    return (maxSizeInBytes - longPieceSize) / shardCount;
+}
+
+std::atomic<LayoutCache*> LayoutCache::sInstance(nullptr);
+
+// static
+LayoutCache* LayoutCache::createInstance() {
+    LayoutCache* cache = new LayoutCache(kDefaultMaxSizeInBytes, kDefaultShardCount,
+                                         true /* useAdmissionFilter */, true /* useThreadCache */);
+    sInstance.store(cache, std::memory_order_release);
+    return cache;
+}
+
+LayoutCache::LayoutCache(size_t maxSizeInBytes, uint32_t shardCount, bool useAdmissionFilter,
+                         bool useThreadCache)
+        : mPartitionCount(1),
+          mUseAdmissionFilter(useAdmissionFilter),
+          mDeduplicatedLayoutCount(0),
+          mActiveLayoutCount(0),
+          mActiveLayoutWaiterCount(0),
+          mUseThreadCache(useThreadCache),
+          mSizeIndependentLayoutEnabled(false),
+          mLetterSpacingDerivationEnabled(false),
+          mGeneration(gNextGeneration++) {
+    LOG_ALWAYS_FATAL_IF(shardCount == 0, "LayoutCache requires at least one shard");
+    mPartitions[kDefaultPartition].store(
+            new Partition(kDefaultPartition, "default", maxSizeInBytes, shardCount,
+                          useAdmissionFilter, false /* pinned */),
+            std::memory_order_relaxed);
+    for (uint32_t i = kDefaultPartition + 1; i < kMaxPartitionCount; ++i) {
+        mPartitions[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+LayoutCache::~LayoutCache() {
+    for (uint32_t i = 0; i < mPartitionCount.load(std::memory_order_relaxed); ++i) {
+        delete mPartitions[i].load(std::memory_order_relaxed);
+    }
+}
+
+LayoutCache::Partition& LayoutCache::getPartition(uint32_t partitionId) {
+    if (partitionId < kMaxPartitionCount) {
+        Partition* partition = mPartitions[partitionId].load(std::memory_order_acquire);
+        if (partition != nullptr) {
+            return *partition;
+        }
+    }
+    return *mPartitions[kDefaultPartition].load(std::memory_order_relaxed);
+}
+
+std::vector<LayoutCache::Shard*> LayoutCache::getShards() {
+    std::vector<Shard*> shards;
+    const uint32_t partitionCount = mPartitionCount.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < partitionCount; ++i) {
+        for (const auto& shard : mPartitions[i].load(std::memory_order_acquire)->mShards) {
+            shards.push_back(shard.get());
+        }
+    }
+    return shards;
+}
+
+uint32_t LayoutCache::getShardCount() const {
+    return mPartitions[kDefaultPartition].load(std::memory_order_relaxed)->getShardCount();
+}
+
+const std::shared_ptr<const LayoutPiece>* LayoutCache::find(Partition& partition,
+                                                            const LayoutCacheKey& key,
+                                                            bool advancesOnly) {
+    Shard& shard = partition.getShard(key);
+    const std::shared_ptr<const LayoutPiece>* layout = shard.find(key);
+    if (layout != nullptr && !isUsable(**layout, advancesOnly)) {
+        layout = nullptr;
+    }
+    const uint64_t hitCount = takePendingHits(this, partition.mId) + (layout != nullptr ? 1 : 0);
+    if (hitCount != 0) {
+        shard.mHitCount.fetch_add(hitCount, std::memory_order_relaxed);
+    }
+    return layout;
+}
+
+const LayoutPiece* LayoutCache::findInThreadCache(const Partition& partition,
+                                                  const LayoutCacheKey& key,
+                                                  uint64_t* generation) {
+    *generation = mGeneration.load(std::memory_order_acquire);
+    if (!mUseThreadCache) {
+        return nullptr;
+    }
+    // The partition is compared too, so that a layout is put in every partition requesting it.
+    const ThreadCacheEntry& entry = getThreadCacheEntry(key);
+    if (entry.generation != *generation || entry.partitionId != partition.mId ||
+        entry.key->hash() != key.hash() || !(*entry.key == key)) {
+        return nullptr;
+    }
+    PendingHitCounts& pending = tPendingHits;
+    if (pending.cache != this) {
+        pending = PendingHitCounts();
+        pending.cache = this;
+    }
+    pending.counts[partition.mId]++;
+    return entry.layout.get();
+}
+
+void LayoutCache::putInThreadCache(const Partition& partition, const LayoutCacheKey& key,
+                                   const std::shared_ptr<const LayoutPiece>& layout,
+                                   uint64_t generation) {
+    // Long texts are not worth copying, and would make the thread caches use a lot of memory.
+    if (!mUseThreadCache || key.text().size() >= LENGTH_LIMIT_CACHE) {
+        return;
+    }
+    ThreadCacheEntry& entry = getThreadCacheEntry(key);
+    const U16StringPiece text = key.text();
+    entry.generation = generation;
+    entry.partitionId = partition.mId;
+    entry.text.assign(text.data(), text.data() + text.size());
+    entry.key = key;
+    entry.key->setTextStorage(entry.text.data());
+    entry.layout = layout;
+}
+
+std::shared_ptr<const LayoutPiece> LayoutCache::getOrCreate(const U16StringPiece& text,
+                                                            const Range& range,
+                                                            const MinikinPaint& paint, bool dir,
+                                                            StartHyphenEdit startHyphen,
+                                                            EndHyphenEdit endHyphen) {
+    if (range.getLength() >= LENGTH_LIMIT_LONG_PIECE_CACHE) {
+        return std::make_shared<LayoutPiece>(text, range, dir, paint, startHyphen, endHyphen);
+    }
+    const bool sizeIndependent = isSizeIndependent(paint);
+    const bool letterSpacingDerived = isLetterSpacingDerived(paint);
+    Partition& partition = getPartition(paint);
+    LayoutCacheKey key(text, range, paint, dir, startHyphen, endHyphen,
+                       sizeIndependent ? kCanonicalTextSize : paint.size, letterSpacingDerived);
+    if (!key.isCacheable()) {
+        return std::make_shared<LayoutPiece>(text, range, dir, paint,
+                                             kUnregisteredFontFeatureSettingsId, startHyphen,
+                                             endHyphen, false /* keepGlyphInfo */,
+                                             false /* advancesOnly */);
+    }
+    std::shared_ptr<const LayoutPiece> layout;
+    uint64_t generation;
+    const LayoutPiece* recent = findInThreadCache(partition, key, &generation);
+    if (recent != nullptr && isUsable(*recent, false /* advancesOnly */)) {
+        layout = getThreadCacheEntry(key).layout;
+    } else {
+        {
+            ReadSection section;
+            const std::shared_ptr<const LayoutPiece>* cached =
+                    find(partition, key, false /* advancesOnly */);
+            if (cached != nullptr) {
+                layout = *cached;
+            }
+        }
+        if (layout == nullptr) {
+            layout = create(partition, key, text, range, paint, dir, startHyphen, endHyphen,
+                            false /* advancesOnly */);
+        }
+        putInThreadCache(partition, key, layout, generation);
+    }
+    if (sizeIndependent || letterSpacingDerived) {
+        return std::make_shared<LayoutPiece>(deriveLayout(*layout, key, paint));
+    }
+    return layout;
+}
+
+LayoutPiece LayoutCache::deriveLayout(const LayoutPiece& layout, const LayoutCacheKey& key,
+                                      const MinikinPaint& paint) {
+    if (!key.isLetterSpacingBase()) {
+        return layout.scaled(paint.size / key.getSize());
+    }
+    // Same as the letter spacing computed in the constructor of LayoutPiece, at the size of the
+    // key so that scaling the result gives the layout of the paint.
+    const LayoutPiece spaced = layout.withLetterSpace(static_cast<double>(paint.letterSpacing) *
+                                                      key.getSize() * paint.scaleX);
+    if (key.getSize() == paint.size) {
+        return spaced;
+    }
+    return spaced.scaled(paint.size / key.getSize());
+}
+
+std::shared_ptr<const LayoutPiece> LayoutCache::create(Partition& partition, LayoutCacheKey& key,
+                                                       const U16StringPiece& text,
+                                                       const Range& range,
+                                                       const MinikinPaint& paint, bool dir,
+                                                       StartHyphenEdit startHyphen,
+                                                       EndHyphenEdit endHyphen,
+                                                       bool advancesOnly) {
+    Shard& shard = partition.getShard(key);
+    bool isPending = false;
+    {
+        std::unique_lock<std::mutex> lock(shard.mMutex);
+        // The layout may have been put after the lock free lookup.
+        const std::shared_ptr<const LayoutPiece>* cached = shard.find(key);
+        if (cached != nullptr && isUsable(**cached, advancesOnly)) {
+            shard.mHitCount.fetch_add(1, std::memory_order_relaxed);
+            return *cached;
+        }
+        shard.recordMiss(key);
+        auto it = shard.mPendingLayouts.find(key);
+        if (it != shard.mPendingLayouts.end() &&
+            (advancesOnly || !it->second->mAdvancesOnly)) {
+            // Another thread is doing the same layout. Wait for it instead of doing it again.
+            std::shared_ptr<PendingLayout> pending = it->second;
+            pending->mCv.wait(lock, [&pending] { return pending->mDone; });
+            mDeduplicatedLayoutCount++;
+            return pending->mLayout;
+        }
+        if (it == shard.mPendingLayouts.end()) {
+            // Nobody is doing this layout. Let the other threads wait for our result.
+            shard.mPendingLayouts.emplace(key, std::make_shared<PendingLayout>(advancesOnly));
+            isPending = true;
+        }
+        // Otherwise another thread is only computing the advances. The full layout is done
+        // without letting other threads wait for it, which is rare.
+    }
+    // Doing text layout takes long time, so releases the mutex during doing layout.
+    mActiveLayoutCount.fetch_add(1, std::memory_order_relaxed);
+    std::shared_ptr<const LayoutPiece> layout;
+    // The features were already interned for the key.
+    const uint32_t featureSettingsId = key.getPaint().fontFeatureSettingsId;
+    if (key.getSize() == paint.size && !key.isLetterSpacingBase()) {
+        layout = std::make_shared<LayoutPiece>(text, range, dir, paint, featureSettingsId,
+                                               startHyphen, endHyphen, false /* keepGlyphInfo */,
+                                               advancesOnly);
+    } else {
+        MinikinPaint keyPaint(paint);
+        keyPaint.size = key.getSize();
+        keyPaint.letterSpacing = key.getLetterSpacing();
+        layout = std::make_shared<LayoutPiece>(text, range, dir, keyPaint, featureSettingsId,
+                                               startHyphen, endHyphen, key.isLetterSpacingBase(),
+                                               advancesOnly);
+    }
+    // Sequentially consistent with waitForActiveLayouts(), so that either the waiter sees the
+    // count of 0 or this thread sees the waiter.
+    if (mActiveLayoutCount.fetch_sub(1) == 1 && mActiveLayoutWaiterCount.load() != 0) {
+        std::lock_guard<std::mutex> lock(mActiveLayoutMutex);
+        mNoActiveLayoutCv.notify_all();
+    }
+    std::shared_ptr<PendingLayout> pending;
+    {
+        std::lock_guard<std::mutex> lock(shard.mMutex);
+        if (isPending) {
+            auto it = shard.mPendingLayouts.find(key);
+            pending = std::move(it->second);
+            shard.mPendingLayouts.erase(it);
+            pending->mDone = true;
+            pending->mLayout = layout;
+        }
+        shard.put(key, layout);
+    }
+    if (pending != nullptr) {
+        pending->mCv.notify_all();
+    }
+    return layout;
+}
+
+void LayoutCache::clear() {
+    for (Shard* shard : getShards()) {
+        std::lock_guard<std::mutex> lock(shard->mMutex);
+        shard->clear();
+    }
+    // Invalidates the thread caches. Their layouts are released when the entries are reused or
+    // the threads exit.
+    mGeneration.store(gNextGeneration++, std::memory_order_release);
+}
+
+void LayoutCache::removeFontCollection(uint32_t fontCollectionId) {
+    if (getCollectionEntryCount(fontCollectionId).load(std::memory_order_relaxed) == 0) {
+        // Neither this instance nor any other one has an entry of the collection.
+        return;
+    }
+    // The keys of a font collection are spread over all the shards, as they are routed by the
+    // text. The thread caches are left as they are, since font collection IDs are never reused.
+    for (Shard* shard : getShards()) {
+        std::lock_guard<std::mutex> lock(shard->mMutex);
+        shard->removeFontCollection(fontCollectionId);
+    }
+}
+
+void LayoutCache::setMaxSizeInBytes(size_t maxSizeInBytes) {
+    getPartition(kDefaultPartition).setMaxSizeInBytes(maxSizeInBytes);
+}
+
+size_t LayoutCache::getMaxSizeInBytes() const {
+    return mPartitions[kDefaultPartition].load(std::memory_order_relaxed)->getMaxSizeInBytes();
+}
+
+size_t LayoutCache::getSizeInBytes() {
+    size_t size = 0;
+    for (Shard* shard : getShards()) {
+        std::lock_guard<std::mutex> lock(shard->mMutex);
+        size += shard->getMemoryUsage();
+    }
+    return size;
+}
+
+uint32_t LayoutCache::createPartition(const std::string& name, size_t maxSizeInBytes,
+                                      bool pinned) {
+    std::lock_guard<std::mutex> lock(mPartitionMutex);
+    const uint32_t partitionCount = mPartitionCount.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < partitionCount; ++i) {
+        Partition* partition = mPartitions[i].load(std::memory_order_relaxed);
+        if (partition->mName == name) {
+            partition->setMaxSizeInBytes(maxSizeInBytes);
+            return i;
+        }
+    }
+    if (partitionCount == kMaxPartitionCount) {
+        ALOGE("Too many layout cache partitions. %s uses the default partition.", name.c_str());
+        return kDefaultPartition;
+    }
+    mPartitions[partitionCount].store(new Partition(partitionCount, name, maxSizeInBytes,
+                                                    kPartitionShardCount, mUseAdmissionFilter,
+                                                    pinned),
+                                      std::memory_order_release);
+    mPartitionCount.store(partitionCount + 1, std::memory_order_release);
+    return partitionCount;
+}
+
+LayoutCache::PartitionStats LayoutCache::getPartitionStats(uint32_t partitionId) {
+    Partition& partition = getPartition(partitionId);
+    // Counts the pending hits of the calling thread too, e.g. when the statistics are read by the
+    // thread doing the layouts.
+    partition.mShards.front()->mHitCount.fetch_add(takePendingHits(this, partition.mId),
+                                                   std::memory_order_relaxed);
+    PartitionStats stats = {};
+    stats.maxSizeInBytes = partition.getMaxSizeInBytes();
+    for (const auto& shard : partition.mShards) {
+        std::lock_guard<std::mutex> lock(shard->mMutex);
+        stats.hitCount += shard->mHitCount.load(std::memory_order_relaxed);
+        stats.missCount += shard->mMissCount;
+        stats.sizeInBytes += shard->mSizeInBytes;
+        stats.entryCount += shard->mCount;
+    }
+    return stats;
+}
+
+bool LayoutCache::writeSnapshot(
+        const std::string& path,
+        const std::vector<std::shared_ptr<FontCollection>>& fontCollections) {
+    std::unordered_map<uint32_t, uint32_t> collectionIndices;
+    std::vector<uint64_t> fingerprints;
+    std::vector<std::unordered_map<const Font*, SnapshotFont>> fontMaps(fontCollections.size());
+    for (uint32_t i = 0; i < fontCollections.size(); ++i) {
+        const FontCollection& collection = *fontCollections[i];
+        collectionIndices[collection.getId()] = i;
+        fingerprints.push_back(collection.getFingerprint());
+        for (uint32_t j = 0; j < collection.getFamilyCount(); ++j) {
+            const FontFamily& family = *collection.getFamilyAt(j);
+            for (uint32_t k = 0; k < family.getNumFonts(); ++k) {
+                fontMaps[i][family.getFont(k)] = SnapshotFont{j, k, 0, 0};
+            }
+        }
+    }
+
+    // The collected entries are not freed before the end of the read section even if they are
+    // evicted in the meantime.
+    ReadSection section;
+    std::vector<SnapshotEntry> entries;
+    for (Shard* shard : getShards()) {
+        std::lock_guard<std::mutex> lock(shard->mMutex);
+        shard->collectEntries(&entries);
+    }
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const SnapshotEntry& l, const SnapshotEntry& r) {
+                         return l.frequency > r.frequency;
+                     });
+
+    struct ResolvedEntry {
+        const SnapshotEntry* entry;
+        uint32_t collectionIndex;
+        uint32_t localeIndex;
+        std::vector<SnapshotFont> fonts;
+    };
+    std::vector<ResolvedEntry> resolved;
+    std::vector<std::string> locales;
+    std::unordered_map<uint32_t, uint32_t> localeIndices;
+    for (const SnapshotEntry& entry : entries) {
+        auto collectionIt = collectionIndices.find(entry.key->getFontCollectionId());
+        // The layouts done with advancesOnly have no glyphs to write.
+        if (collectionIt == collectionIndices.end() || entry.key->isLetterSpacingBase() ||
+            entry.layout->isAdvancesOnly()) {
+            continue;
+        }
+        const auto& fontMap = fontMaps[collectionIt->second];
+        std::vector<SnapshotFont> fonts;
+        for (const FakedFont& font : entry.layout->fonts()) {
+            auto fontIt = fontMap.find(font.font);
+            if (fontIt == fontMap.end()) {
+                break;
+            }
+            FontFakery fakery = font.fakery;
+            fonts.push_back(fontIt->second);
+            fonts.back().fakeBold = fakery.isFakeBold();
+            fonts.back().fakeItalic = fakery.isFakeItalic();
+        }
+        if (fonts.size() != entry.layout->fonts().size()) {
+            continue;
+        }
+        auto localeIt = localeIndices.find(entry.key->getLocaleListId());
+        if (localeIt == localeIndices.end()) {
+            localeIt = localeIndices.emplace(entry.key->getLocaleListId(), locales.size()).first;
+            locales.push_back(LocaleListCache::getString(entry.key->getLocaleListId()));
+        }
+        resolved.push_back({&entry, collectionIt->second, localeIt->second, std::move(fonts)});
+    }
+
+    auto writeSnapshotTo = [&](BufferWriter* writer) {
+        writer->write(kSnapshotMagic);
+        writer->write(kSnapshotVersion);
+        writer->writeArray(fingerprints.data(), fingerprints.size());
+        writer->write<uint32_t>(locales.size());
+        for (const std::string& locale : locales) {
+            writer->writeString(locale);
+        }
+        writer->write<uint32_t>(resolved.size());
+        for (const ResolvedEntry& entry : resolved) {
+            writer->write(entry.collectionIndex);
+            writer->write(entry.localeIndex);
+            writer->write(entry.entry->frequency);
+            entry.entry->key->writeTo(writer);
+            writeLayoutPiece(writer, *entry.entry->layout, entry.fonts);
+        }
+    };
+    BufferWriter fakeWriter(nullptr);
+    writeSnapshotTo(&fakeWriter);
+    std::vector<uint8_t> buffer(fakeWriter.size());
+    BufferWriter writer(buffer.data());
+    writeSnapshotTo(&writer);
+
+    // Write to a temporary file first so that a reader never sees a partially written snapshot.
+    const std::string tmpPath = path + ".tmp";
+    FILE* file = fopen(tmpPath.c_str(), "wb");
+    if (file == nullptr) {
+        ALOGE("Failed to open %s for writing the layout cache snapshot", tmpPath.c_str());
+        return false;
+    }
+    const bool written = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    if (fclose(file) != 0 || !written || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        ALOGE("Failed to write the layout cache snapshot to %s", path.c_str());
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+size_t LayoutCache::readSnapshot(
+        const std::string& path,
+        const std::vector<std::shared_ptr<FontCollection>>& fontCollections) {
+    MappedFile file(path);
+    if (file.data() == nullptr) {
+        return 0;
+    }
+    BufferReader reader(file.data(), file.size());
+    if (reader.read<uint32_t>() != kSnapshotMagic ||
+        reader.read<uint32_t>() != kSnapshotVersion) {
+        ALOGW("Ignoring the incompatible layout cache snapshot %s", path.c_str());
+        return 0;
+    }
+
+    // Only the layouts done with exactly the same fonts are used.
+    uint32_t collectionCount;
+    const uint64_t* fingerprints = reader.readArray<uint64_t>(&collectionCount);
+    std::vector<const FontCollection*> collections(collectionCount, nullptr);
+    for (const auto& collection : fontCollections) {
+        const uint64_t fingerprint = collection->getFingerprint();
+        for (uint32_t i = 0; i < collectionCount; ++i) {
+            if (fingerprints[i] == fingerprint) {
+                collections[i] = collection.get();
+            }
+        }
+    }
+
+    const uint32_t localeCount = reader.read<uint32_t>();
+    std::vector<uint32_t> localeListIds;
+    for (uint32_t i = 0; i < localeCount && !reader.hasError(); ++i) {
+        localeListIds.push_back(LocaleListCache::getId(reader.readString()));
+    }
+
+    size_t loadedCount = 0;
+    const uint32_t entryCount = reader.read<uint32_t>();
+    for (uint32_t i = 0; i < entryCount && !reader.hasError(); ++i) {
+        const uint32_t collectionIndex = reader.read<uint32_t>();
+        const uint32_t localeIndex = reader.read<uint32_t>();
+        const uint32_t frequency = reader.read<uint32_t>();
+        const FontCollection* collection =
+                collectionIndex < collections.size() ? collections[collectionIndex] : nullptr;
+        const bool isValidLocale = localeIndex < localeListIds.size();
+        SnapshotKey snapshotKey(&reader);
+        std::shared_ptr<const LayoutPiece> layout =
+                readLayoutPiece(&reader, collection, snapshotKey.count);
+        if (layout == nullptr || !isValidLocale || !snapshotKey.isValidRange() ||
+            reader.hasError()) {
+            continue;
+        }
+        LayoutCacheKey key = snapshotKey.toKey(collection->getId(), localeListIds[localeIndex]);
+        if (!key.isCacheable()) {
+            continue;
+        }
+        Shard& shard = getPartition(kDefaultPartition).getShard(key);
+        std::lock_guard<std::mutex> lock(shard.mMutex);
+        if (shard.load(key, layout, frequency)) {
+            loadedCount++;
+        }
+    }
+    return loadedCount;
+}
+
+uint64_t LayoutCache::getMissCount() {
+    uint64_t count = 0;
+    for (Shard* shard : getShards()) {
+        std::lock_guard<std::mutex> lock(shard->mMutex);
+        count += shard->mMissCount;
+    }
+    return count;
+}
+
+bool LayoutCache::waitForActiveLayouts(std::chrono::milliseconds timeout) {
+    if (mActiveLayoutCount.load() == 0) {
+        return true;
+    }
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    std::unique_lock<std::mutex> lock(mActiveLayoutMutex);
+    mActiveLayoutWaiterCount.fetch_add(1);
+    bool idle = mActiveLayoutCount.load() == 0;
+    while (!idle &&
+           mNoActiveLayoutCv.wait_until(lock, deadline) == std::cv_status::no_timeout) {
+        idle = mActiveLayoutCount.load() == 0;
+    }
+    mActiveLayoutWaiterCount.fetch_sub(1);
+    return idle;
+}
+
+uint32_t LayoutCache::getCacheSize() {
+    uint32_t size = 0;
+    for (Shard* shard : getShards()) {
+        std::lock_guard<std::mutex> lock(shard->mMutex);
+        size += shard->mCount;
+    }
+    return size;
+}
+
+}  // namespace minikin
@@ -18,10 +18,11 @@
 
 #include "minikin/LayoutCore.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
-#include <mutex>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include <hb-icu.h>
@@ -29,7 +30,6 @@
 #include <log/log.h>
 #include <unicode/ubidi.h>
 #include <unicode/utf16.h>
-#include <utils/LruCache.h>
 
 #include "minikin/Emoji.h"
 #include "minikin/HbUtils.h"
@@ -38,103 +38,69 @@
 #include "minikin/Macros.h"
 
 #include "BidiUtils.h"
+#include "FontFeatureCache.h"
+#include "GlyphBoundsCache.h"
+#include "HbFontCache.h"
 #include "LayoutUtils.h"
 #include "LocaleListCache.h"
 #include "MinikinInternal.h"
+#include "ShapePlanCache.h"
 
 namespace minikin {
 
 namespace {
 
-struct SkiaArguments {
-    const MinikinFont* font;
-    const MinikinPaint* paint;
-    FontFakery fakery;
-};
-
 // Returns true if the character needs to be excluded for the line spacing.
 inline bool isLineSpaceExcludeChar(uint16_t c) {
     return c == CHAR_LINE_FEED || c == CHAR_CARRIAGE_RETURN;
 }
 
-static hb_position_t harfbuzzGetGlyphHorizontalAdvance(hb_font_t* /* hbFont */, void* fontData,
-                                                       hb_codepoint_t glyph, void* /* userData */) {
-    SkiaArguments* args = reinterpret_cast<SkiaArguments*>(fontData);
-    float advance = args->font->GetHorizontalAdvance(glyph, *args->paint, args->fakery);
-    return 256 * advance + 0.5;
-}
+// The HarfBuzz buffer of the thread, reused by the layouts instead of creating one for each word.
+struct ThreadHbBuffer {
+    ThreadHbBuffer() : inUse(false) {}
 
-static void harfbuzzGetGlyphHorizontalAdvances(hb_font_t* /* hbFont */, void* fontData,
-                                               unsigned int count,
-                                               const hb_codepoint_t* first_glyph,
-                                               unsigned glyph_stride, hb_position_t* first_advance,
-                                               unsigned advance_stride, void* /* userData */) {
-    SkiaArguments* args = reinterpret_cast<SkiaArguments*>(fontData);
-    std::vector<uint16_t> glyphVec(count);
-    std::vector<float> advVec(count);
-
-    const hb_codepoint_t* glyph = first_glyph;
-    for (uint32_t i = 0; i < count; ++i) {
-        glyphVec[i] = *glyph;
-        glyph = reinterpret_cast<const hb_codepoint_t*>(reinterpret_cast<const uint8_t*>(glyph) +
-                                                        glyph_stride);
-    }
+    HbBufferUniquePtr buffer;
+    bool inUse;
+};
 
-    args->font->GetHorizontalAdvances(glyphVec.data(), count, *args->paint, args->fakery,
-                                      advVec.data());
+thread_local ThreadHbBuffer tHbBuffer;
+
+// Lends the buffer of the thread, or a buffer of its own if the thread's buffer is already lent or
+// the text is long, so that the thread doesn't keep the memory of a long text for its lifetime.
+class HbBufferLease {
+public:
+    explicit HbBufferLease(size_t length)
+            : mThreadBuffer(tHbBuffer.inUse || length > kMaxLength ? nullptr : &tHbBuffer) {
+        if (mThreadBuffer == nullptr) {
+            mOwnBuffer.reset(hb_buffer_create());
+            return;
+        }
+        if (!mThreadBuffer->buffer) {
+            mThreadBuffer->buffer.reset(hb_buffer_create());
+        }
+        mThreadBuffer->inUse = true;
+    }
 
-    hb_position_t* advances = first_advance;
-    for (uint32_t i = 0; i < count; ++i) {
-        *advances = HBFloatToFixed(advVec[i]);
-        advances = reinterpret_cast<hb_position_t*>(reinterpret_cast<uint8_t*>(advances) +
-                                                    advance_stride);
+    ~HbBufferLease() {
+        if (mThreadBuffer == nullptr) {
+            return;
+        }
+        hb_buffer_clear_contents(mThreadBuffer->buffer.get());
+        mThreadBuffer->inUse = false;
     }
-}
 
-static hb_bool_t harfbuzzGetGlyphHorizontalOrigin(hb_font_t* /* hbFont */, void* /* fontData */,
-                                                  hb_codepoint_t /* glyph */,
-                                                  hb_position_t* /* x */, hb_position_t* /* y */,
-                                                  void* /* userData */) {
-    // Just return true, following the way that Harfbuzz-FreeType implementation does.
-    return true;
-}
+    const HbBufferUniquePtr& get() const {
+        return mThreadBuffer == nullptr ? mOwnBuffer : mThreadBuffer->buffer;
+    }
 
-hb_font_funcs_t* getFontFuncs() {
-    static hb_font_funcs_t* fontFuncs = nullptr;
-    static std::once_flag once;
-    std::call_once(once, [&]() {
-        fontFuncs = hb_font_funcs_create();
-        // Override the h_advance function since we can't use HarfBuzz's implemenation. It may
-        // return the wrong value if the font uses hinting aggressively.
-        hb_font_funcs_set_glyph_h_advance_func(fontFuncs, harfbuzzGetGlyphHorizontalAdvance, 0, 0);
-        hb_font_funcs_set_glyph_h_advances_func(fontFuncs, harfbuzzGetGlyphHorizontalAdvances, 0,
-                                                0);
-        hb_font_funcs_set_glyph_h_origin_func(fontFuncs, harfbuzzGetGlyphHorizontalOrigin, 0, 0);
-        hb_font_funcs_make_immutable(fontFuncs);
-    });
-    return fontFuncs;
-}
+private:
+    static const size_t kMaxLength = 4096;
 
-hb_font_funcs_t* getFontFuncsForEmoji() {
-    static hb_font_funcs_t* fontFuncs = nullptr;
-    static std::once_flag once;
-    std::call_once(once, [&]() {
-        fontFuncs = hb_font_funcs_create();
-        // Don't override the h_advance function since we use HarfBuzz's implementation for emoji
-        // for performance reasons.
-        // Note that it is technically possible for a TrueType font to have outline and embedded
-        // bitmap at the same time. We ignore modified advances of hinted outline glyphs in that
-        // case.
-        hb_font_funcs_set_glyph_h_origin_func(fontFuncs, harfbuzzGetGlyphHorizontalOrigin, 0, 0);
-        hb_font_funcs_make_immutable(fontFuncs);
-    });
-    return fontFuncs;
-}
+    ThreadHbBuffer* mThreadBuffer;
+    HbBufferUniquePtr mOwnBuffer;
 
-static bool isColorBitmapFont(const HbFontUniquePtr& font) {
-    HbBlob cbdt(font, HB_TAG('C', 'B', 'D', 'T'));
-    return cbdt;
-}
+    MINIKIN_PREVENT_COPY_AND_ASSIGN(HbBufferLease);
+};
 
 static hb_codepoint_t decodeUtf16(const uint16_t* chars, size_t len, ssize_t* iter) {
     UChar32 result;
@@ -189,20 +155,6 @@ static bool isScriptOkForLetterspacing(hb_script_t script) {
              script == HB_SCRIPT_TIRHUTA || script == HB_SCRIPT_OGHAM);
 }
 
-static void addFeatures(const std::string& str, std::vector<hb_feature_t>* features) {
-    SplitIterator it(str, ',');
-    while (it.hasNext()) {
-        StringPiece featureStr = it.next();
-        static hb_feature_t feature;
-        /* We do not allow setting features on ranges.  As such, reject any
-         * setting that has non-universal range. */
-        if (hb_feature_from_string(featureStr.data(), featureStr.size(), &feature) &&
-            feature.start == 0 && feature.end == (unsigned int)-1) {
-            features->push_back(feature);
-        }
-    }
-}
-
 static inline hb_codepoint_t determineHyphenChar(hb_codepoint_t preferredHyphen, hb_font_t* font) {
     hb_codepoint_t glyph;
     if (preferredHyphen == 0x058A    /* ARMENIAN_HYPHEN */
@@ -341,45 +293,60 @@ static inline uint32_t addToHbBuffer(const HbBufferUniquePtr& buffer, const uint
 
 LayoutPiece::LayoutPiece(const U16StringPiece& textBuf, const Range& range, bool isRtl,
                          const MinikinPaint& paint, StartHyphenEdit startHyphen,
-                         EndHyphenEdit endHyphen) {
+                         EndHyphenEdit endHyphen, bool keepGlyphInfo, bool advancesOnly)
+        : LayoutPiece(textBuf, range, isRtl, paint,
+                      FontFeatureCache::getId(paint.fontFeatureSettings), startHyphen, endHyphen,
+                      keepGlyphInfo, advancesOnly) {}
+
+LayoutPiece::LayoutPiece(const U16StringPiece& textBuf, const Range& range, bool isRtl,
+                         const MinikinPaint& paint, uint32_t featureSettingsId,
+                         StartHyphenEdit startHyphen, EndHyphenEdit endHyphen, bool keepGlyphInfo,
+                         bool advancesOnly)
+        : LayoutPiece() {
     const uint16_t* buf = textBuf.data();
     const size_t start = range.getStart();
     const size_t count = range.getLength();
     const size_t bufSize = textBuf.size();
 
-    mAdvances.resize(count, 0);  // Need zero filling.
-
+    // Collected in vectors, and packed into mData once the number of glyphs is known.
+    std::vector<FakedFont> fonts;
+    std::vector<uint8_t> fontIndices;
+    std::vector<uint16_t> glyphIds;
     // Usually the number of glyphs are less than number of code units.
-    mFontIndices.reserve(count);
-    mGlyphIds.reserve(count);
-    mPoints.reserve(count);
+    fontIndices.reserve(count);
+    glyphIds.reserve(count);
+    std::vector<GlyphInfo> glyphs;
+    glyphs.reserve(count);
 
-    HbBufferUniquePtr buffer(hb_buffer_create());
+    HbBufferLease bufferLease(count);
+    const HbBufferUniquePtr& buffer = bufferLease.get();
     std::vector<FontCollection::Run> items = paint.font->itemize(
             textBuf.substr(range), paint.fontStyle, paint.localeListId, paint.familyVariant);
 
-    std::vector<hb_feature_t> features;
-    // Disable default-on non-required ligature features if letter-spacing
-    // See http://dev.w3.org/csswg/css-text-3/#letter-spacing-property
-    // "When the effective spacing between two characters is not zero (due to
-    // either justification or a non-zero value of letter-spacing), user agents
-    // should not apply optional ligatures."
-    if (fabs(paint.letterSpacing) > 0.03) {
-        static const hb_feature_t no_liga = {HB_TAG('l', 'i', 'g', 'a'), 0, 0, ~0u};
-        static const hb_feature_t no_clig = {HB_TAG('c', 'l', 'i', 'g'), 0, 0, ~0u};
-        features.push_back(no_liga);
-        features.push_back(no_clig);
-    }
-    addFeatures(paint.fontFeatureSettings, &features);
+    // The optional ligatures are disabled for letter spacing.
+    const bool disableLigatures = isLigatureDisabledByLetterSpacing(paint.letterSpacing);
+    // The settings which didn't fit in FontFeatureCache are parsed for each layout.
+    const bool isRegisteredFeatures = featureSettingsId != FontFeatureCache::kUnregisteredId;
+    const std::vector<hb_feature_t> unregisteredFeatures =
+            isRegisteredFeatures
+                    ? std::vector<hb_feature_t>()
+                    : FontFeatureCache::parse(paint.fontFeatureSettings, disableLigatures);
+    const std::vector<hb_feature_t>& features =
+            isRegisteredFeatures ? FontFeatureCache::getById(featureSettingsId, disableLigatures)
+                                 : unregisteredFeatures;
 
     std::vector<HbFontUniquePtr> hbFonts;
+    std::vector<bool> colorBitmapFonts;
     double size = paint.size;
     double scaleX = paint.scaleX;
+    const double letterSpace = paint.letterSpacing * size * scaleX;
 
     std::unordered_map<const Font*, uint32_t> fontMap;
 
-    float x = 0;
-    float y = 0;
+    // The glyphs of a script run and their bounds, measured together.
+    std::vector<uint16_t> runGlyphIds;
+    std::vector<MinikinRect> runBounds;
+
     for (int run_ix = isRtl ? items.size() - 1 : 0;
          isRtl ? run_ix >= 0 : run_ix < static_cast<int>(items.size());
          isRtl ? --run_ix : ++run_ix) {
@@ -389,17 +356,13 @@ LayoutPiece::LayoutPiece(const U16StringPiece& textBuf, const Range& range, bool
         uint8_t font_ix;
         if (it == fontMap.end()) {
             // First time to see this font.
-            font_ix = mFonts.size();
-            mFonts.push_back(fakedFont);
+            font_ix = fonts.size();
+            fonts.push_back(fakedFont);
             fontMap.insert(std::make_pair(fakedFont.font, font_ix));
 
-            // We override some functions which are not thread safe.
-            HbFontUniquePtr font(hb_font_create_sub_font(fakedFont.font->baseFont().get()));
-            hb_font_set_funcs(
-                    font.get(), isColorBitmapFont(font) ? getFontFuncsForEmoji() : getFontFuncs(),
-                    new SkiaArguments({fakedFont.font->typeface().get(), &paint, fakedFont.fakery}),
-                    [](void* data) { delete reinterpret_cast<SkiaArguments*>(data); });
-            hbFonts.push_back(std::move(font));
+            bool isColorBitmapFont;
+            hbFonts.push_back(HbFontCache::getInstance().get(fakedFont, paint, &isColorBitmapFont));
+            colorBitmapFonts.push_back(isColorBitmapFont);
         } else {
             font_ix = it->second;
         }
@@ -418,10 +381,7 @@ LayoutPiece::LayoutPiece(const U16StringPiece& textBuf, const Range& range, bool
             mExtent.extendBy(verticalExtent);
         }
 
-        hb_font_set_ppem(hbFont.get(), size * scaleX, size);
-        hb_font_set_scale(hbFont.get(), HBFloatToFixed(size * scaleX), HBFloatToFixed(size));
-
-        const bool is_color_bitmap_font = isColorBitmapFont(hbFont);
+        const bool is_color_bitmap_font = colorBitmapFonts[font_ix];
 
         // TODO: if there are multiple scripts within a font in an RTL run,
         // we need to reorder those runs. This is unlikely with our current
@@ -441,13 +401,7 @@ LayoutPiece::LayoutPiece(const U16StringPiece& textBuf, const Range& range, bool
             // (scriptRunStart == run.end) which is impossible due to the exit condition of the for
             // loop. So we can be sure that scriptRunEnd > scriptRunStart.
 
-            double letterSpace = 0.0;
-            double letterSpaceHalf = 0.0;
-
-            if (paint.letterSpacing != 0.0 && isScriptOkForLetterspacing(script)) {
-                letterSpace = paint.letterSpacing * size * scaleX;
-                letterSpaceHalf = letterSpace * 0.5;
-            }
+            const bool isLetterSpacingAllowed = isScriptOkForLetterspacing(script);
 
             hb_buffer_clear_contents(buffer.get());
             hb_buffer_set_script(buffer.get(), script);
@@ -468,78 +422,256 @@ LayoutPiece::LayoutPiece(const U16StringPiece& textBuf, const Range& range, bool
                     addToHbBuffer(buffer, buf, start, count, bufSize, scriptRunStart, scriptRunEnd,
                                   startHyphen, endHyphen, hbFont);
 
-            hb_shape(hbFont.get(), buffer.get(), features.empty() ? NULL : &features[0],
-                     features.size());
+            hb_segment_properties_t props;
+            hb_buffer_get_segment_properties(buffer.get(), &props);
+            HbShapePlanUniquePtr plan =
+                    isRegisteredFeatures
+                            ? ShapePlanCache::getInstance().get(hbFont.get(), props,
+                                                                featureSettingsId,
+                                                                disableLigatures)
+                            : ShapePlanCache::create(hbFont.get(), props, features);
+            hb_shape_plan_execute(plan.get(), hbFont.get(), buffer.get(),
+                                  features.empty() ? NULL : &features[0], features.size());
+            // As hb_shape() does.
+            hb_buffer_set_content_type(buffer.get(), HB_BUFFER_CONTENT_TYPE_GLYPHS);
             unsigned int numGlyphs;
             hb_glyph_info_t* info = hb_buffer_get_glyph_infos(buffer.get(), &numGlyphs);
             hb_glyph_position_t* positions = hb_buffer_get_glyph_positions(buffer.get(), NULL);
 
+            if (!advancesOnly && !is_color_bitmap_font) {
+                runGlyphIds.clear();
+                for (unsigned int i = 0; i < numGlyphs; i++) {
+                    runGlyphIds.push_back(static_cast<uint16_t>(info[i].codepoint));
+                }
+                runBounds.resize(numGlyphs);
+                GlyphBoundsCache::getInstance().getBounds(fakedFont.font->typeface(), paint,
+                                                          fakedFont.fakery, runGlyphIds.data(),
+                                                          numGlyphs, runBounds.data());
+            }
+
             // At this point in the code, the cluster values in the info buffer correspond to the
             // input characters with some shift. The cluster value clusterStart corresponds to the
             // first character passed to HarfBuzz, which is at buf[start + scriptRunStart] whose
-            // advance needs to be saved into mAdvances[scriptRunStart]. So cluster values need to
-            // be reduced by (clusterStart - scriptRunStart) to get converted to indices of
-            // mAdvances.
+            // advance needs to be saved into advances()[scriptRunStart]. So cluster values need
+            // to be reduced by (clusterStart - scriptRunStart) to get converted to indices of
+            // advances().
             const ssize_t clusterOffset = clusterStart - scriptRunStart;
 
-            if (numGlyphs) {
-                mAdvances[info[0].cluster - clusterOffset] += letterSpaceHalf;
-                x += letterSpaceHalf;
-            }
             for (unsigned int i = 0; i < numGlyphs; i++) {
-                const size_t clusterBaseIndex = info[i].cluster - clusterOffset;
-                if (i > 0 && info[i - 1].cluster != info[i].cluster) {
-                    mAdvances[info[i - 1].cluster - clusterOffset] += letterSpaceHalf;
-                    mAdvances[clusterBaseIndex] += letterSpaceHalf;
-                    x += letterSpace;
-                }
-
                 hb_codepoint_t glyph_ix = info[i].codepoint;
                 float xoff = HBFixedToFloat(positions[i].x_offset);
                 float yoff = -HBFixedToFloat(positions[i].y_offset);
                 xoff += yoff * paint.skewX;
-                mFontIndices.push_back(font_ix);
-                mGlyphIds.push_back(glyph_ix);
-                mPoints.emplace_back(x + xoff, y + yoff);
-                float xAdvance = HBFixedToFloat(positions[i].x_advance);
                 MinikinRect glyphBounds;
-                hb_glyph_extents_t extents = {};
-                if (is_color_bitmap_font &&
-                    hb_font_get_glyph_extents(hbFont.get(), glyph_ix, &extents)) {
-                    // Note that it is technically possible for a TrueType font to have outline and
-                    // embedded bitmap at the same time. We ignore modified bbox of hinted outline
-                    // glyphs in that case.
-                    glyphBounds.mLeft = roundf(HBFixedToFloat(extents.x_bearing));
-                    glyphBounds.mTop = roundf(HBFixedToFloat(-extents.y_bearing));
-                    glyphBounds.mRight = roundf(HBFixedToFloat(extents.x_bearing + extents.width));
-                    glyphBounds.mBottom =
-                            roundf(HBFixedToFloat(-extents.y_bearing - extents.height));
-                } else {
-                    fakedFont.font->typeface()->GetBounds(&glyphBounds, glyph_ix, paint,
-                                                          fakedFont.fakery);
-                }
-                glyphBounds.offset(xoff, yoff);
-
-                if (clusterBaseIndex < count) {
-                    mAdvances[clusterBaseIndex] += xAdvance;
-                } else {
-                    ALOGE("cluster %zu (start %zu) out of bounds of count %zu", clusterBaseIndex,
-                          start, count);
+                if (!advancesOnly) {
+                    fontIndices.push_back(font_ix);
+                    // OpenType limits the glyph IDs to 16 bits.
+                    glyphIds.push_back(static_cast<uint16_t>(glyph_ix));
+                    hb_glyph_extents_t extents = {};
+                    if (is_color_bitmap_font &&
+                        hb_font_get_glyph_extents(hbFont.get(), glyph_ix, &extents)) {
+                        // Note that it is technically possible for a TrueType font to have outline
+                        // and embedded bitmap at the same time. We ignore modified bbox of hinted
+                        // outline glyphs in that case.
+                        glyphBounds.mLeft = roundf(HBFixedToFloat(extents.x_bearing));
+                        glyphBounds.mTop = roundf(HBFixedToFloat(-extents.y_bearing));
+                        glyphBounds.mRight =
+                                roundf(HBFixedToFloat(extents.x_bearing + extents.width));
+                        glyphBounds.mBottom =
+                                roundf(HBFixedToFloat(-extents.y_bearing - extents.height));
+                    } else if (is_color_bitmap_font) {
+                        fakedFont.font->typeface()->GetBounds(&glyphBounds, glyph_ix, paint,
+                                                              fakedFont.fakery);
+                    } else {
+                        glyphBounds = runBounds[i];
+                    }
+                    glyphBounds.offset(xoff, yoff);
                 }
-                glyphBounds.offset(x, y);
-                mBounds.join(glyphBounds);
-                x += xAdvance;
+                glyphs.push_back({static_cast<size_t>(info[i].cluster - clusterOffset),
+                                  HBFixedToFloat(positions[i].x_advance), Point(xoff, yoff),
+                                  glyphBounds, i == 0, isLetterSpacingAllowed});
             }
-            if (numGlyphs) {
-                mAdvances[info[numGlyphs - 1].cluster - clusterOffset] += letterSpaceHalf;
-                x += letterSpaceHalf;
+        }
+    }
+    mAdvancesOnly = advancesOnly;
+    if (advancesOnly) {
+        fonts.clear();
+    }
+    allocate(glyphIds.size(), count, fonts.size());
+    std::copy(fonts.begin(), fonts.end(), fontsData());
+    std::copy(glyphIds.begin(), glyphIds.end(), glyphIdsData());
+    std::copy(fontIndices.begin(), fontIndices.end(), fontIndicesData());
+    std::fill_n(advancesData(), count, 0.0f);
+    placeGlyphs(glyphs, letterSpace);
+    if (keepGlyphInfo) {
+        glyphs.shrink_to_fit();
+        mGlyphInfos = std::move(glyphs);
+    }
+}
+
+LayoutPiece::LayoutPiece(Span<const uint8_t> fontIndices, Span<const uint16_t> glyphIds,
+                         Span<const Point> points, Span<const float> advances, float advance,
+                         const MinikinRect& bounds, const MinikinExtent& extent,
+                         Span<const FakedFont> fonts)
+        : LayoutPiece() {
+    mAdvance = advance;
+    mBounds = bounds;
+    mExtent = extent;
+    allocate(glyphIds.size(), advances.size(), fonts.size());
+    std::copy(fonts.begin(), fonts.end(), fontsData());
+    std::copy(points.begin(), points.end(), pointsData());
+    std::copy(advances.begin(), advances.end(), advancesData());
+    std::copy(glyphIds.begin(), glyphIds.end(), glyphIdsData());
+    std::copy(fontIndices.begin(), fontIndices.end(), fontIndicesData());
+}
+
+LayoutPiece::LayoutPiece(const LayoutPiece& o)
+        : mGlyphCount(0),
+          mAdvanceCount(0),
+          mFontCount(0),
+          mAdvance(o.mAdvance),
+          mBounds(o.mBounds),
+          mExtent(o.mExtent),
+          mAdvancesOnly(o.mAdvancesOnly),
+          mGlyphInfos(o.mGlyphInfos) {
+    allocate(o.mGlyphCount, o.mAdvanceCount, o.mFontCount);
+    std::copy_n(o.mData.get(), getDataSize(), mData.get());
+}
+
+LayoutPiece::LayoutPiece(LayoutPiece&& o)
+        : mData(std::move(o.mData)),
+          mGlyphCount(o.mGlyphCount),
+          mAdvanceCount(o.mAdvanceCount),
+          mFontCount(o.mFontCount),
+          mAdvance(o.mAdvance),
+          mBounds(o.mBounds),
+          mExtent(o.mExtent),
+          mAdvancesOnly(o.mAdvancesOnly),
+          mGlyphInfos(std::move(o.mGlyphInfos)) {
+    // Leave the moved-from layout empty, so that its spans don't point to the moved data.
+    o.mGlyphCount = 0;
+    o.mAdvanceCount = 0;
+    o.mFontCount = 0;
+}
+
+LayoutPiece& LayoutPiece::operator=(const LayoutPiece& o) {
+    if (this != &o) {
+        *this = LayoutPiece(o);
+    }
+    return *this;
+}
+
+LayoutPiece& LayoutPiece::operator=(LayoutPiece&& o) {
+    if (this != &o) {
+        mData = std::move(o.mData);
+        mGlyphCount = o.mGlyphCount;
+        mAdvanceCount = o.mAdvanceCount;
+        mFontCount = o.mFontCount;
+        mAdvance = o.mAdvance;
+        mBounds = o.mBounds;
+        mExtent = o.mExtent;
+        mAdvancesOnly = o.mAdvancesOnly;
+        mGlyphInfos = std::move(o.mGlyphInfos);
+        o.mGlyphCount = 0;
+        o.mAdvanceCount = 0;
+        o.mFontCount = 0;
+    }
+    return *this;
+}
+
+void LayoutPiece::allocate(uint32_t glyphCount, uint32_t advanceCount, uint32_t fontCount) {
+    // The pointer returned by new[] is aligned for any of the arrays, and each array is followed
+    // by ones with the same or smaller alignments.
+    static_assert(alignof(FakedFont) >= alignof(Point), "Points would be misaligned");
+    static_assert(alignof(Point) >= alignof(float), "Advances would be misaligned");
+    static_assert(alignof(float) >= alignof(uint16_t), "Glyph IDs would be misaligned");
+    static_assert(std::is_trivially_copyable<FakedFont>::value &&
+                          std::is_trivially_copyable<Point>::value,
+                  "The arrays are copied as bytes");
+    mGlyphCount = glyphCount;
+    mAdvanceCount = advanceCount;
+    mFontCount = fontCount;
+    mData.reset(new uint8_t[getDataSize()]);
+}
+
+void LayoutPiece::placeGlyphs(const std::vector<GlyphInfo>& glyphs, double letterSpace) {
+    const size_t count = mAdvanceCount;
+    Point* points = pointsData();
+    float* advances = advancesData();
+
+    float x = 0;
+    float y = 0;
+    double runLetterSpace = 0.0;
+    double runLetterSpaceHalf = 0.0;
+    for (size_t i = 0; i < glyphs.size(); i++) {
+        const GlyphInfo& glyph = glyphs[i];
+        if (glyph.startsScriptRun) {
+            if (i > 0) {
+                // The end of the previous script run.
+                advances[glyphs[i - 1].cluster] += runLetterSpaceHalf;
+                x += runLetterSpaceHalf;
             }
+            runLetterSpace = glyph.isLetterSpacingAllowed ? letterSpace : 0.0;
+            runLetterSpaceHalf = runLetterSpace * 0.5;
+            advances[glyph.cluster] += runLetterSpaceHalf;
+            x += runLetterSpaceHalf;
+        } else if (glyphs[i - 1].cluster != glyph.cluster) {
+            advances[glyphs[i - 1].cluster] += runLetterSpaceHalf;
+            advances[glyph.cluster] += runLetterSpaceHalf;
+            x += runLetterSpace;
+        }
+
+        if (glyph.cluster < count) {
+            advances[glyph.cluster] += glyph.xAdvance;
+        } else {
+            ALOGE("cluster %zu out of bounds of count %zu", glyph.cluster, count);
+        }
+        if (!mAdvancesOnly) {
+            points[i] = Point(x + glyph.offset.x, y + glyph.offset.y);
+            MinikinRect glyphBounds(glyph.bounds);
+            glyphBounds.offset(x, y);
+            mBounds.join(glyphBounds);
         }
+        x += glyph.xAdvance;
+    }
+    if (!glyphs.empty()) {
+        advances[glyphs.back().cluster] += runLetterSpaceHalf;
+        x += runLetterSpaceHalf;
     }
-    mFontIndices.shrink_to_fit();
-    mGlyphIds.shrink_to_fit();
-    mPoints.shrink_to_fit();
     mAdvance = x;
 }
 
+LayoutPiece LayoutPiece::withLetterSpace(double letterSpace) const {
+    LayoutPiece layout;
+    layout.mAdvancesOnly = mAdvancesOnly;
+    layout.allocate(mGlyphCount, mAdvanceCount, mFontCount);
+    std::copy_n(fontsData(), mFontCount, layout.fontsData());
+    std::copy_n(glyphIdsData(), mGlyphCount, layout.glyphIdsData());
+    std::copy_n(fontIndicesData(), mGlyphCount, layout.fontIndicesData());
+    std::fill_n(layout.advancesData(), mAdvanceCount, 0.0f);
+    layout.mExtent = mExtent;
+    layout.placeGlyphs(mGlyphInfos, letterSpace);
+    return layout;
+}
+
+LayoutPiece LayoutPiece::scaled(float ratio) const {
+    LayoutPiece layout;
+    layout.mAdvancesOnly = mAdvancesOnly;
+    layout.allocate(mGlyphCount, mAdvanceCount, mFontCount);
+    std::copy_n(mData.get(), getDataSize(), layout.mData.get());
+    Point* points = layout.pointsData();
+    for (uint32_t i = 0; i < mGlyphCount; ++i) {
+        points[i] = Point(points[i].x * ratio, points[i].y * ratio);
+    }
+    float* advances = layout.advancesData();
+    for (uint32_t i = 0; i < mAdvanceCount; ++i) {
+        advances[i] *= ratio;
+    }
+    layout.mAdvance = mAdvance * ratio;
+    layout.mBounds = MinikinRect(mBounds.mLeft * ratio, mBounds.mTop * ratio,
+                                 mBounds.mRight * ratio, mBounds.mBottom * ratio);
+    layout.mExtent = MinikinExtent(mExtent.ascent * ratio, mExtent.descent * ratio);
+    return layout;
+}
+
 }  // namespace minikin
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Minikin"
+
+#include "LayoutPaintCache.h"
+
+#include <string>
+
+#include <log/log.h>
+
+#include "minikin/FontCollection.h"
+
+#include "FontFeatureCache.h"
+#include "MinikinInternal.h"
+
+namespace minikin {
+
+namespace {
+
+// The last paint registered by a thread, to which the thread holds a reference. Text is laid out
+// word by word with the same paint, so this saves the lock and the lookup of the global table for
+// most of the words.
+struct RecentPaint {
+    RecentPaint() : valid(false) {}
+    ~RecentPaint() {
+        if (valid) {
+            LayoutPaintCache::release(id);
+        }
+    }
+
+    bool valid;
+    std::string fontFeatureSettings;
+    LayoutPaint paint;
+    uint32_t id;
+};
+
+thread_local RecentPaint tRecentPaint;
+
+}  // namespace
+
+uint32_t registerLayoutPaint(const LayoutPaint& paint) {
+    return LayoutPaintCache::getId(paint);
+}
+
+uint32_t registerLayoutPaint(const MinikinPaint& paint, float size, float letterSpacing,
+                             bool isLetterSpacingBase) {
+    RecentPaint& recent = tRecentPaint;
+    const bool sameFeatures =
+            recent.valid && recent.fontFeatureSettings == paint.fontFeatureSettings;
+    const LayoutPaint layoutPaint = {
+            paint.font->getId(),
+            paint.fontStyle,
+            size,
+            paint.scaleX,
+            paint.skewX,
+            letterSpacing,
+            paint.wordSpacing,
+            static_cast<int32_t>(paint.fontFlags),
+            paint.localeListId,
+            paint.familyVariant,
+            sameFeatures ? recent.paint.fontFeatureSettingsId
+                         : FontFeatureCache::getId(paint.fontFeatureSettings),
+            isLetterSpacingBase,
+    };
+    if (sameFeatures && recent.paint == layoutPaint) {
+        return recent.id;
+    }
+    const uint32_t id = LayoutPaintCache::getId(layoutPaint);
+    if (recent.valid) {
+        LayoutPaintCache::release(recent.id);
+    }
+    recent.valid = true;
+    recent.fontFeatureSettings = paint.fontFeatureSettings;
+    recent.paint = layoutPaint;
+    recent.id = id;
+    return id;
+}
+
+void acquireLayoutPaint(uint32_t id) {
+    LayoutPaintCache::acquire(id);
+}
+
+void releaseLayoutPaint(uint32_t id) {
+    LayoutPaintCache::release(id);
+}
+
+const LayoutPaint& getLayoutPaint(uint32_t id) {
+    return LayoutPaintCache::getById(id);
+}
+
+LayoutPaintCache::LayoutPaintCache() : mIdCount(0), mSize(0) {
+    for (uint32_t i = 0; i < kMaxBlockCount; ++i) {
+        mBlocks[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+void LayoutPaintCache::locate(uint32_t id, uint32_t* block, uint32_t* index) {
+    // The blocks before block k hold kFirstBlockSize * (2^k - 1) paints in total.
+    const uint32_t n = id / kFirstBlockSize + 1;
+    *block = 31 - __builtin_clz(n);
+    *index = id - kFirstBlockSize * ((1u << *block) - 1);
+}
+
+uint32_t LayoutPaintCache::getIdInternal(const LayoutPaint& paint) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    const auto& it = mLookupTable.find(paint);
+    if (it != mLookupTable.end()) {
+        // The reference count may be zero if the last reference is being released, in which case
+        // the releasing thread finds it incremented and keeps the ID.
+        getSlot(it->second).refCount.fetch_add(1, std::memory_order_relaxed);
+        return it->second;
+    }
+
+    // Given paint is not in cache. Insert it and return newly assigned ID.
+    uint32_t id;
+    if (!mFreeIds.empty()) {
+        id = mFreeIds.back();
+        mFreeIds.pop_back();
+    } else {
+        id = mIdCount.load(std::memory_order_relaxed);
+        LOG_ALWAYS_FATAL_IF(id == UINT32_MAX, "Too many layout paints");
+        uint32_t block, index;
+        locate(id, &block, &index);
+        if (mBlocks[block].load(std::memory_order_relaxed) == nullptr) {
+            mBlocks[block].store(new Slot[kFirstBlockSize << block], std::memory_order_release);
+        }
+        mIdCount.store(id + 1, std::memory_order_release);
+    }
+    Slot& slot = getSlot(id);
+    slot.paint = paint;
+    slot.refCount.store(1, std::memory_order_relaxed);
+    slot.live = true;
+    mLookupTable.insert(std::make_pair(paint, id));
+    mSize.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+void LayoutPaintCache::releaseInternal(uint32_t id) {
+    Slot& slot = getSlot(id);
+    if (slot.refCount.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    // Another thread may have found the paint in the table meanwhile, or released it again after
+    // that and freed the ID already.
+    if (slot.refCount.load(std::memory_order_acquire) != 0 || !slot.live) {
+        return;
+    }
+    slot.live = false;
+    mLookupTable.erase(slot.paint);
+    mFreeIds.push_back(id);
+    mSize.fetch_sub(1, std::memory_order_relaxed);
+}
+
+LayoutPaintCache::Slot& LayoutPaintCache::getSlot(uint32_t id) {
+    MINIKIN_ASSERT(id < mIdCount.load(std::memory_order_acquire), "Lookup by unknown paint ID.");
+    uint32_t block, index;
+    locate(id, &block, &index);
+    return mBlocks[block].load(std::memory_order_acquire)[index];
+}
+
+}  // namespace minikin
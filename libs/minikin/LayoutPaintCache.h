@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_LAYOUT_PAINT_CACHE_H
+#define MINIKIN_LAYOUT_PAINT_CACHE_H
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "minikin/LayoutPaint.h"
+#include "minikin/Macros.h"
+
+namespace minikin {
+
+// Interns LayoutPaints into IDs, so that LayoutCacheKey can hash and compare a single integer
+// instead of every field of the paint.
+//
+// The IDs are reference counted by the keys using them, so that the paints of the layouts evicted
+// from the cache, e.g. the sizes of an animation or the paints of a destroyed font collection, are
+// released and the table stays as large as the paints in use. A released ID is reused for the next
+// new paint.
+//
+// The paints are stored in blocks which never move, block k holding kFirstBlockSize << k paints,
+// so that getById() can read them without the lock. A thread obtaining an ID, either from getId()
+// or from a LayoutCacheKey published by another thread, also sees the paint stored before the ID
+// was handed out.
+class LayoutPaintCache {
+public:
+    // Returns the ID of the paint with a new reference to it.
+    static uint32_t getId(const LayoutPaint& paint) { return getInstance().getIdInternal(paint); }
+
+    // Adds a reference to the paint of an ID, which the caller must already hold a reference to.
+    static void acquire(uint32_t id) {
+        getInstance().getSlot(id).refCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void release(uint32_t id) { getInstance().releaseInternal(id); }
+
+    static const LayoutPaint& getById(uint32_t id) { return getInstance().getSlot(id).paint; }
+
+    // Returns the number of interned paints which are in use.
+    static uint32_t getSize() { return getInstance().mSize.load(std::memory_order_relaxed); }
+
+private:
+    LayoutPaintCache();  // Singleton
+
+    struct Slot {
+        LayoutPaint paint;
+        std::atomic<uint32_t> refCount;
+        // False once the ID is released. Only accessed with mMutex held.
+        bool live;
+    };
+
+    uint32_t getIdInternal(const LayoutPaint& paint);
+    void releaseInternal(uint32_t id);
+    Slot& getSlot(uint32_t id);
+
+    static LayoutPaintCache& getInstance() {
+        // Never destructed, as the keys of the global LayoutCache, which is never destructed
+        // either, refer to the paints.
+        static LayoutPaintCache* instance = new LayoutPaintCache();
+        return *instance;
+    }
+
+    // Computes the block of the given ID and the index in the block.
+    static void locate(uint32_t id, uint32_t* block, uint32_t* index);
+
+    struct PaintHasher {
+        std::size_t operator()(const LayoutPaint& paint) const { return paint.hash(); }
+    };
+
+    static const uint32_t kFirstBlockSize = 64;
+    // Enough blocks for every 32-bit ID.
+    static const uint32_t kMaxBlockCount = 27;
+
+    std::atomic<Slot*> mBlocks[kMaxBlockCount];
+    // The number of IDs ever handed out, including the released ones.
+    std::atomic<uint32_t> mIdCount;
+    std::atomic<uint32_t> mSize;
+
+    std::unordered_map<LayoutPaint, uint32_t, PaintHasher> mLookupTable GUARDED_BY(mMutex);
+    std::vector<uint32_t> mFreeIds GUARDED_BY(mMutex);
+
+    std::mutex mMutex;
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_LAYOUT_PAINT_CACHE_H
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Minikin"
+
+#include "minikin/LayoutPrefetcher.h"
+
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+
+#include <log/log.h>
+
+#include "BidiUtils.h"
+#include "LayoutSplitter.h"
+
+namespace minikin {
+
+namespace {
+
+// The nice value of the background thread, same as ANDROID_PRIORITY_BACKGROUND.
+const int kPrefetchThreadPriority = 10;
+
+// How long the background thread waits for the layouts of other threads before laying out the
+// next word anyway, so that prefetching still progresses while the foreground is always busy, and
+// a cancellation is noticed while waiting.
+const std::chrono::milliseconds kMaxYieldTime(8);
+
+// The layouts are only put into the cache.
+struct IgnoreLayout {
+    void operator()(const LayoutPiece& /* layout */, const MinikinPaint& /* paint */) {}
+};
+
+}  // namespace
+
+LayoutPrefetcher::LayoutPrefetcher(LayoutCache* cache)
+        : mCache(cache), mCancelled(false), mNextBatchId(1), mRunningBatchId(0), mStopped(false) {}
+
+LayoutPrefetcher::~LayoutPrefetcher() {
+    std::thread thread;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopped = true;
+        mQueue.clear();
+        mCancelled = true;
+        thread = std::move(mThread);
+    }
+    mQueueCv.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+uint64_t LayoutPrefetcher::prefetch(std::vector<Request>&& requests) {
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        id = mNextBatchId++;
+        mQueue.push_back({id, std::move(requests)});
+        if (!mThread.joinable()) {
+            mThread = std::thread(&LayoutPrefetcher::run, this);
+        }
+    }
+    mQueueCv.notify_one();
+    return id;
+}
+
+void LayoutPrefetcher::cancel(uint64_t batchId) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mRunningBatchId == batchId) {
+        mCancelled = true;
+        return;
+    }
+    auto it = std::find_if(mQueue.begin(), mQueue.end(),
+                           [batchId](const Batch& batch) { return batch.id == batchId; });
+    if (it != mQueue.end()) {
+        mQueue.erase(it);
+        mIdleCv.notify_all();
+    }
+}
+
+void LayoutPrefetcher::cancelAll() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mQueue.clear();
+    mCancelled = true;
+    mIdleCv.notify_all();
+}
+
+void LayoutPrefetcher::waitUntilIdle() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mQueue.empty() || mRunningBatchId != 0) {
+        mIdleCv.wait(lock);
+    }
+}
+
+void LayoutPrefetcher::run() {
+#if defined(__linux__)
+    // On Linux, the nice value of PRIO_PROCESS 0 is the one of the calling thread only.
+    if (setpriority(PRIO_PROCESS, 0, kPrefetchThreadPriority) != 0) {
+        ALOGW("Failed to lower the priority of the layout prefetch thread");
+    }
+#endif
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (;;) {
+        while (!mStopped && mQueue.empty()) {
+            mQueueCv.wait(lock);
+        }
+        if (mStopped) {
+            return;
+        }
+        Batch batch = std::move(mQueue.front());
+        mQueue.pop_front();
+        mRunningBatchId = batch.id;
+        mCancelled = false;
+
+        lock.unlock();
+        prefetchBatch(batch);
+        lock.lock();
+
+        mRunningBatchId = 0;
+        mIdleCv.notify_all();
+    }
+}
+
+void LayoutPrefetcher::prefetchBatch(const Batch& batch) {
+    IgnoreLayout ignoreLayout;
+    for (const Request& request : batch.requests) {
+        const U16StringPiece textBuf(request.text);
+        const Range range(0, textBuf.size());
+        // Same words as the ones laid out by Layout::measureText().
+        for (const BidiText::RunInfo& runInfo : BidiText(textBuf, range, request.bidiFlags)) {
+            if (!runInfo.range.isValid()) {
+                continue;
+            }
+            for (const auto[context, piece] :
+                 LayoutSplitter(textBuf, runInfo.range, runInfo.isRtl)) {
+                yieldToForeground();
+                if (mCancelled) {
+                    return;
+                }
+                mCache->getOrCreate(textBuf.substr(context), piece - context.getStart(),
+                                    request.paint, runInfo.isRtl, StartHyphenEdit::NO_EDIT,
+                                    EndHyphenEdit::NO_EDIT, ignoreLayout);
+            }
+        }
+    }
+}
+
+void LayoutPrefetcher::yieldToForeground() {
+    // This thread is between two words, so all the layouts in progress are done by other threads.
+    mCache->waitForActiveLayouts(kMaxYieldTime);
+}
+
+}  // namespace minikin
@@ -111,6 +111,7 @@ LocaleListCache::LocaleListCache() {
     // Insert an empty locale list for mapping default locale list to kEmptyListId.
     // The default locale list has only one Locale and it is the unsupported locale.
     mLocaleLists.emplace_back();
+    mLocaleListStrings.emplace_back();
     mLocaleListLookupTable.insert(std::make_pair("", kEmptyListId));
 }
 
@@ -128,6 +129,7 @@ uint32_t LocaleListCache::getIdInternal(const std::string& locales) {
         return kEmptyListId;
     }
     mLocaleLists.push_back(std::move(fontLocales));
+    mLocaleListStrings.push_back(locales);
     mLocaleListLookupTable.insert(std::make_pair(locales, nextId));
     return nextId;
 }
@@ -138,4 +140,10 @@ const LocaleList& LocaleListCache::getByIdInternal(uint32_t id) {
     return mLocaleLists[id];
 }
 
+std::string LocaleListCache::getStringInternal(uint32_t id) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    MINIKIN_ASSERT(id < mLocaleListStrings.size(), "Lookup by unknown locale list ID.");
+    return mLocaleListStrings[id];
+}
+
 }  // namespace minikin
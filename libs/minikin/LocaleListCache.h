@@ -18,6 +18,7 @@
 #define MINIKIN_LOCALE_LIST_CACHE_H
 
 #include <mutex>
+#include <string>
 #include <unordered_map>
 
 #include "minikin/Macros.h"
@@ -47,12 +48,19 @@ public:
         return getInstance().getByIdInternal(id);
     }
 
+    // Returns the string which was passed to getId() when the ID was assigned. Unlike the ID, the
+    // string can be used across processes.
+    static inline std::string getString(uint32_t id) {
+        return getInstance().getStringInternal(id);
+    }
+
 private:
     LocaleListCache();  // Singleton
     ~LocaleListCache() {}
 
     uint32_t getIdInternal(const std::string& locales);
     const LocaleList& getByIdInternal(uint32_t id);
+    std::string getStringInternal(uint32_t id);
 
     // Caller should acquire a lock before calling the method.
     static LocaleListCache& getInstance() {
@@ -62,6 +70,9 @@ private:
 
     std::vector<LocaleList> mLocaleLists GUARDED_BY(mMutex);
 
+    // The string representations of mLocaleLists.
+    std::vector<std::string> mLocaleListStrings GUARDED_BY(mMutex);
+
     // A map from the string representation of the font locale list to the ID.
     std::unordered_map<std::string, uint32_t> mLocaleListLookupTable GUARDED_BY(mMutex);
 
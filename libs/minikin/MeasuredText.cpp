@@ -38,7 +38,7 @@ public:
     }
 
     void operator()(const LayoutPiece& layoutPiece, const MinikinPaint& paint) {
-        const std::vector<float>& advances = layoutPiece.advances();
+        const Span<const float> advances = layoutPiece.advances();
         std::copy(advances.begin(), advances.end(), mOutAdvances->begin() + mRange.getStart());
 
         if (mOutPieces != nullptr) {
@@ -56,6 +56,8 @@ private:
 void StyleRun::getMetrics(const U16StringPiece& textBuf, std::vector<float>* advances,
                           LayoutPieces* precomputed, LayoutPieces* outPieces) const {
     AdvancesCompositor compositor(advances, outPieces);
+    // The pieces are kept for drawing the text later. Otherwise only the advances are needed.
+    const bool advancesOnly = outPieces == nullptr;
     const Bidi bidiFlag = mIsRtl ? Bidi::FORCE_RTL : Bidi::FORCE_LTR;
     const uint32_t paintId =
             (precomputed == nullptr) ? LayoutPieces::kNoPaintId : precomputed->findPaintId(mPaint);
@@ -65,11 +67,12 @@ void StyleRun::getMetrics(const U16StringPiece& textBuf, std::vector<float>* adv
             if (paintId == LayoutPieces::kNoPaintId) {
                 LayoutCache::getInstance().getOrCreate(
                         textBuf.substr(context), piece - context.getStart(), mPaint, info.isRtl,
-                        StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, compositor);
+                        StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, advancesOnly,
+                        compositor);
             } else {
                 precomputed->getOrCreate(textBuf, piece, context, mPaint, info.isRtl,
                                          StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, paintId,
-                                         compositor);
+                                         advancesOnly, compositor);
             }
         }
     }
@@ -116,9 +119,9 @@ float StyleRun::measureHyphenPiece(const U16StringPiece& textBuf, const Range& r
                     piece.getEnd() == range.getEnd() ? endHyphen : EndHyphenEdit::NO_EDIT;
 
             compositor.setNextContext(piece, packHyphenEdit(startEdit, endEdit), info.isRtl);
-            LayoutCache::getInstance().getOrCreate(textBuf.substr(context),
-                                                   piece - context.getStart(), mPaint, info.isRtl,
-                                                   startEdit, endEdit, compositor);
+            LayoutCache::getInstance().getOrCreate(
+                    textBuf.substr(context), piece - context.getStart(), mPaint, info.isRtl,
+                    startEdit, endEdit, pieces == nullptr /* advancesOnly */, compositor);
         }
     }
     return compositor.advance();
@@ -267,7 +270,7 @@ MinikinExtent StyleRun::getExtent(const U16StringPiece& textBuf, const Range& ra
         for (const auto[context, piece] : LayoutSplitter(textBuf, info.range, info.isRtl)) {
             pieces.getOrCreate(textBuf, piece, context, mPaint, info.isRtl,
                                StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, paintId,
-                               compositor);
+                               true /* advancesOnly */, compositor);
         }
     }
     return compositor.extent();
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ShapePlanCache.h"
+
+#include "minikin/Hasher.h"
+
+#include "FontFeatureCache.h"
+
+namespace minikin {
+
+namespace {
+
+// The source of ShapePlanCache::mGeneration. 0 is never used, so that the empty recent plan of a
+// thread never matches.
+std::atomic<uint64_t> gNextGeneration(1);
+
+}  // namespace
+
+thread_local ShapePlanCache::RecentPlan ShapePlanCache::tRecentPlan;
+
+ShapePlanCache::ShapePlanCache(uint32_t maxSize)
+        : mMaxSize(maxSize), mGeneration(gNextGeneration++) {}
+
+void ShapePlanCache::clear() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mPlans.clear();
+        mLruKeys.clear();
+    }
+    // Invalidates the recent plans of the threads. Their references are released when the
+    // threads look up a plan again or exit.
+    mGeneration.store(gNextGeneration++, std::memory_order_release);
+}
+
+std::size_t ShapePlanCache::KeyHasher::operator()(const Key& key) const {
+    const uintptr_t face = reinterpret_cast<uintptr_t>(key.face);
+    const uintptr_t language = reinterpret_cast<uintptr_t>(key.language);
+    Hasher hasher;
+    hasher.update(static_cast<uint32_t>(face))
+            .update(static_cast<uint32_t>(static_cast<uint64_t>(face) >> 32))
+            .update(key.direction)
+            .update(key.script)
+            .update(static_cast<uint32_t>(language))
+            .update(static_cast<uint32_t>(static_cast<uint64_t>(language) >> 32))
+            .update(key.featureSettingsId)
+            .update(key.disableLigatures)
+            .update(key.coords.size());
+    for (int coord : key.coords) {
+        hasher.update(coord);
+    }
+    return hasher.hash();
+}
+
+// static
+HbShapePlanUniquePtr ShapePlanCache::create(hb_font_t* font, const hb_segment_properties_t& props,
+                                            const std::vector<hb_feature_t>& features) {
+    unsigned int coordCount = 0;
+    const int* coords = hb_font_get_var_coords_normalized(font, &coordCount);
+    return HbShapePlanUniquePtr(hb_shape_plan_create2(hb_font_get_face(font), &props,
+                                                      features.empty() ? nullptr : &features[0],
+                                                      features.size(), coords, coordCount,
+                                                      nullptr));
+}
+
+HbShapePlanUniquePtr ShapePlanCache::get(hb_font_t* font, const hb_segment_properties_t& props,
+                                         uint32_t featureSettingsId, bool disableLigatures) {
+    unsigned int coordCount = 0;
+    const int* coords = hb_font_get_var_coords_normalized(font, &coordCount);
+    hb_face_t* face = hb_font_get_face(font);
+    Key key;
+    key.face = face;
+    key.direction = props.direction;
+    key.script = props.script;
+    key.language = props.language;
+    key.featureSettingsId = featureSettingsId;
+    key.disableLigatures = disableLigatures;
+    key.coords.assign(coords, coords + coordCount);
+
+    const uint64_t generation = mGeneration.load(std::memory_order_acquire);
+    RecentPlan& recent = tRecentPlan;
+    if (recent.generation == generation && recent.key == key) {
+        return HbShapePlanUniquePtr(hb_shape_plan_reference(recent.entry.plan.get()));
+    }
+
+    HbShapePlanUniquePtr plan;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mPlans.find(key);
+        if (it != mPlans.end()) {
+            mLruKeys.splice(mLruKeys.begin(), mLruKeys, it->second.lruPosition);
+            plan.reset(hb_shape_plan_reference(it->second.plan.get()));
+        }
+    }
+    if (!plan) {
+        // Created without the lock, as planning compiles the lookups of the features. If another
+        // thread created the same plan meanwhile, either of them can be used.
+        plan = create(font, props, FontFeatureCache::getById(featureSettingsId, disableLigatures));
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mPlans.find(key) == mPlans.end()) {
+            if (mPlans.size() >= mMaxSize) {
+                // The layouts shaping with the dropped plan hold references to it.
+                mPlans.erase(mLruKeys.back());
+                mLruKeys.pop_back();
+            }
+            mLruKeys.push_front(key);
+            mPlans.emplace(key, Entry{HbFaceUniquePtr(hb_face_reference(face)),
+                                      HbShapePlanUniquePtr(hb_shape_plan_reference(plan.get())),
+                                      mLruKeys.begin()});
+        }
+    }
+
+    // Releases the references to the previous plan, which may be from before clear().
+    recent.generation = generation;
+    recent.key = std::move(key);
+    recent.entry.face.reset(hb_face_reference(face));
+    recent.entry.plan.reset(hb_shape_plan_reference(plan.get()));
+    return plan;
+}
+
+}  // namespace minikin
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_SHAPE_PLAN_CACHE_H
+#define MINIKIN_SHAPE_PLAN_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <hb.h>
+
+#include "minikin/HbUtils.h"
+#include "minikin/Macros.h"
+
+namespace minikin {
+
+// Caches the HarfBuzz shape plans per face, variation coordinates, script, direction, language and
+// features, so that shaping a run doesn't look for a plan in the list HarfBuzz keeps per face and
+// compare the features of each one.
+//
+// The features are identified by a FontFeatureCache ID and whether the optional ligatures are
+// disabled, and must be passed to hb_shape_plan_execute() as returned by
+// FontFeatureCache::getById(). A plan doesn't hold a reference to its face, so the entries do, as
+// the address of the face is part of the key and another face must not be allocated at that
+// address while the entry exists. The least recently used plan is dropped when the cache is full.
+class ShapePlanCache {
+public:
+    static ShapePlanCache& getInstance() {
+        // Never destructed, as layouts may be created by threads still running at exit.
+        static ShapePlanCache* instance = new ShapePlanCache(kMaxSize);
+        return *instance;
+    }
+
+    // Returns a new reference to the plan for shaping a buffer of the given properties with the
+    // font and features.
+    HbShapePlanUniquePtr get(hb_font_t* font, const hb_segment_properties_t& props,
+                             uint32_t featureSettingsId, bool disableLigatures);
+
+    // Creates a plan without caching it, e.g. for the features of unregistered settings.
+    static HbShapePlanUniquePtr create(hb_font_t* font, const hb_segment_properties_t& props,
+                                       const std::vector<hb_feature_t>& features);
+
+    void clear();
+
+    uint32_t getSize() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mPlans.size();
+    }
+
+protected:
+    explicit ShapePlanCache(uint32_t maxSize);
+
+private:
+    static const uint32_t kMaxSize = 256;
+
+    struct Key {
+        bool operator==(const Key& o) const {
+            return face == o.face && direction == o.direction && script == o.script &&
+                   language == o.language && featureSettingsId == o.featureSettingsId &&
+                   disableLigatures == o.disableLigatures && coords == o.coords;
+        }
+
+        const hb_face_t* face;
+        hb_direction_t direction;
+        hb_script_t script;
+        hb_language_t language;
+        uint32_t featureSettingsId;
+        bool disableLigatures;
+        // The normalized variation coordinates of the font, usually none.
+        std::vector<int> coords;
+    };
+
+    struct KeyHasher {
+        std::size_t operator()(const Key& key) const;
+    };
+
+    struct Entry {
+        HbFaceUniquePtr face;
+        HbShapePlanUniquePtr plan;
+        // The position of the key in mLruKeys. Unused by the recent plan of the thread.
+        std::list<Key>::iterator lruPosition;
+    };
+
+    // The last plan returned to the thread, as the words of a paragraph are usually shaped with
+    // the same plan. Reused without taking the lock while the generation is the one of the cache.
+    struct RecentPlan {
+        RecentPlan() : generation(0) {}
+
+        uint64_t generation;
+        Key key;
+        Entry entry;
+    };
+
+    static thread_local RecentPlan tRecentPlan;
+
+    const uint32_t mMaxSize;
+
+    // Changed by clear() to invalidate the recent plans of the threads. Generations are unique
+    // among all the instances, so the recent plan of a thread never matches another instance.
+    std::atomic<uint64_t> mGeneration;
+
+    std::unordered_map<Key, Entry, KeyHasher> mPlans GUARDED_BY(mMutex);
+    // The keys of mPlans, most recently used first.
+    std::list<Key> mLruKeys GUARDED_BY(mMutex);
+
+    std::mutex mMutex;
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_SHAPE_PLAN_CACHE_H
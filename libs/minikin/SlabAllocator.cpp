@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "SlabAllocator.h"
+
+#include <algorithm>
+#include <new>
+
+namespace minikin {
+
+namespace {
+
+size_t alignToMaxAlign(size_t size) {
+    return (size + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) *
+           alignof(std::max_align_t);
+}
+
+size_t roundUpToPowerOfTwo(size_t size) {
+    size_t result = 1;
+    while (result < size) {
+        result <<= 1;
+    }
+    return result;
+}
+
+}  // namespace
+
+SlabAllocator::SlabAllocator(size_t blockSize)
+        // Every block must be able to hold a free list node and be aligned for any type.
+        : mBlockSize(alignToMaxAlign(std::max(blockSize, sizeof(FreeBlock)))),
+          mHeaderSize(alignToMaxAlign(sizeof(Chunk))),
+          mChunkSize(roundUpToPowerOfTwo(mHeaderSize + mBlockSize * kMinBlocksPerChunk)),
+          mBlocksPerChunk((mChunkSize - mHeaderSize) / mBlockSize),
+          mAvailableChunks(nullptr),
+          mFullChunks(nullptr),
+          mChunkCount(0) {}
+
+SlabAllocator::~SlabAllocator() {
+    for (Chunk* list : {mAvailableChunks, mFullChunks}) {
+        while (list != nullptr) {
+            Chunk* next = list->next;
+            deleteChunk(list);
+            list = next;
+        }
+    }
+}
+
+void* SlabAllocator::allocate() {
+    if (mAvailableChunks == nullptr) {
+        pushFront(&mAvailableChunks, newChunk());
+    }
+    Chunk* chunk = mAvailableChunks;
+    FreeBlock* block = chunk->freeList;
+    chunk->freeList = block->next;
+    if (--chunk->freeCount == 0) {
+        unlink(&mAvailableChunks, chunk);
+        pushFront(&mFullChunks, chunk);
+    }
+    return block;
+}
+
+void SlabAllocator::free(void* block) {
+    const uintptr_t address = reinterpret_cast<uintptr_t>(block);
+    Chunk* chunk = reinterpret_cast<Chunk*>(address & ~(mChunkSize - 1));
+    FreeBlock* freeBlock = reinterpret_cast<FreeBlock*>(block);
+    freeBlock->next = chunk->freeList;
+    chunk->freeList = freeBlock;
+    if (++chunk->freeCount == mBlocksPerChunk) {
+        unlink(&mAvailableChunks, chunk);
+        deleteChunk(chunk);
+    } else if (chunk->freeCount == 1) {
+        unlink(&mFullChunks, chunk);
+        pushFront(&mAvailableChunks, chunk);
+    }
+}
+
+SlabAllocator::Chunk* SlabAllocator::newChunk() {
+    uint8_t* memory =
+            reinterpret_cast<uint8_t*>(::operator new(mChunkSize, std::align_val_t(mChunkSize)));
+    Chunk* chunk = new (memory) Chunk();
+    chunk->prev = nullptr;
+    chunk->next = nullptr;
+    chunk->freeList = nullptr;
+    for (uint32_t i = mBlocksPerChunk; i > 0; --i) {
+        FreeBlock* block =
+                reinterpret_cast<FreeBlock*>(memory + mHeaderSize + mBlockSize * (i - 1));
+        block->next = chunk->freeList;
+        chunk->freeList = block;
+    }
+    chunk->freeCount = mBlocksPerChunk;
+    mChunkCount++;
+    return chunk;
+}
+
+void SlabAllocator::deleteChunk(Chunk* chunk) {
+    chunk->~Chunk();
+    ::operator delete(chunk, std::align_val_t(mChunkSize));
+    mChunkCount--;
+}
+
+void SlabAllocator::pushFront(Chunk** list, Chunk* chunk) {
+    chunk->prev = nullptr;
+    chunk->next = *list;
+    if (*list != nullptr) {
+        (*list)->prev = chunk;
+    }
+    *list = chunk;
+}
+
+void SlabAllocator::unlink(Chunk** list, Chunk* chunk) {
+    if (chunk->prev != nullptr) {
+        chunk->prev->next = chunk->next;
+    } else {
+        *list = chunk->next;
+    }
+    if (chunk->next != nullptr) {
+        chunk->next->prev = chunk->prev;
+    }
+}
+
+}  // namespace minikin
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef MINIKIN_SLAB_ALLOCATOR_H
+#define MINIKIN_SLAB_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "minikin/Macros.h"
+
+namespace minikin {
+
+// Allocates blocks of a fixed size from large chunks. This avoids going through the global
+// allocator for objects which are frequently created and destroyed, e.g. cache entries.
+//
+// Each chunk keeps the list of its free blocks, and is returned to the system as soon as all its
+// blocks are freed, so that emptying a cache also releases its memory. The chunks are aligned to
+// their size, so that the chunk of a block is found from the address of the block.
+//
+// This class is not thread-safe.
+class SlabAllocator {
+public:
+    explicit SlabAllocator(size_t blockSize);
+    ~SlabAllocator();
+
+    void* allocate();
+    void free(void* block);
+
+    size_t getBlockSize() const { return mBlockSize; }
+
+    // Returns the memory reserved by this allocator, including the free blocks.
+    size_t getReservedSizeInBytes() const { return mChunkCount * mChunkSize; }
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct Chunk {
+        Chunk* prev;
+        Chunk* next;
+        FreeBlock* freeList;
+        uint32_t freeCount;
+    };
+
+    // A chunk holds at least this many blocks.
+    static const size_t kMinBlocksPerChunk = 64;
+
+    Chunk* newChunk();
+    void deleteChunk(Chunk* chunk);
+    static void pushFront(Chunk** list, Chunk* chunk);
+    static void unlink(Chunk** list, Chunk* chunk);
+
+    const size_t mBlockSize;
+    // The offset of the first block from the beginning of its chunk.
+    const size_t mHeaderSize;
+    // A power of two.
+    const size_t mChunkSize;
+    const uint32_t mBlocksPerChunk;
+    // The chunks which have free blocks, and the ones which don't.
+    Chunk* mAvailableChunks;
+    Chunk* mFullChunks;
+    size_t mChunkCount;
+
+    MINIKIN_PREVENT_COPY_AND_ASSIGN(SlabAllocator);
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_SLAB_ALLOCATOR_H
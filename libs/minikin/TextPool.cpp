@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TextPool.h"
+
+#include <algorithm>
+
+namespace minikin {
+
+// A string and its header, followed by the characters.
+struct TextPool::Block {
+    Block* next;
+    uint32_t hash;
+    uint32_t length;
+    uint32_t refCount;
+
+    uint16_t* chars() { return reinterpret_cast<uint16_t*>(this + 1); }
+};
+
+namespace {
+
+const uint32_t kInitialBucketCount = 64;
+
+}  // namespace
+
+TextPool::TextPool() : mBuckets(kInitialBucketCount, nullptr), mCount(0) {
+    for (uint32_t i = 0; i < kSizeClassCount; ++i) {
+        mSlabs.emplace_back(new SlabAllocator(sizeof(Block) +
+                                              sizeof(uint16_t) * kCharsPerSizeClass * (i + 1)));
+    }
+}
+
+TextPool::~TextPool() {
+    for (Block* head : mBuckets) {
+        while (head != nullptr) {
+            Block* next = head->next;
+            freeBlock(head);
+            head = next;
+        }
+    }
+}
+
+const uint16_t* TextPool::intern(const U16StringPiece& text, uint32_t hash) {
+    Block** bucket = &mBuckets[hash & (mBuckets.size() - 1)];
+    for (Block* block = *bucket; block != nullptr; block = block->next) {
+        if (block->hash == hash && block->length == text.size() &&
+            std::equal(text.data(), text.data() + text.size(), block->chars())) {
+            block->refCount++;
+            return block->chars();
+        }
+    }
+
+    Block* block = allocateBlock(text.size());
+    block->hash = hash;
+    block->length = text.size();
+    block->refCount = 1;
+    std::copy(text.data(), text.data() + text.size(), block->chars());
+    block->next = *bucket;
+    *bucket = block;
+    if (++mCount > mBuckets.size()) {
+        grow();
+    }
+    return block->chars();
+}
+
+void TextPool::release(const uint16_t* chars) {
+    Block* block = reinterpret_cast<Block*>(const_cast<uint16_t*>(chars)) - 1;
+    if (--block->refCount != 0) {
+        return;
+    }
+    Block** link = &mBuckets[block->hash & (mBuckets.size() - 1)];
+    while (*link != block) {
+        link = &(*link)->next;
+    }
+    *link = block->next;
+    freeBlock(block);
+    if (--mCount == 0 && mBuckets.size() > kInitialBucketCount) {
+        // Give the memory of the table back once the pool is emptied, e.g. by clearing the cache.
+        std::vector<Block*>(kInitialBucketCount, nullptr).swap(mBuckets);
+    }
+}
+
+TextPool::Block* TextPool::allocateBlock(uint32_t length) {
+    const uint32_t sizeClass = length == 0 ? 0 : (length - 1) / kCharsPerSizeClass;
+    if (sizeClass < kSizeClassCount) {
+        return reinterpret_cast<Block*>(mSlabs[sizeClass]->allocate());
+    }
+    return reinterpret_cast<Block*>(new uint8_t[sizeof(Block) + sizeof(uint16_t) * length]);
+}
+
+void TextPool::freeBlock(Block* block) {
+    const uint32_t sizeClass = block->length == 0 ? 0 : (block->length - 1) / kCharsPerSizeClass;
+    if (sizeClass < kSizeClassCount) {
+        mSlabs[sizeClass]->free(block);
+    } else {
+        delete[] reinterpret_cast<uint8_t*>(block);
+    }
+}
+
+void TextPool::grow() {
+    std::vector<Block*> buckets(mBuckets.size() * 2, nullptr);
+    for (Block* head : mBuckets) {
+        while (head != nullptr) {
+            Block* next = head->next;
+            Block** bucket = &buckets[head->hash & (buckets.size() - 1)];
+            head->next = *bucket;
+            *bucket = head;
+            head = next;
+        }
+    }
+    mBuckets.swap(buckets);
+}
+
+}  // namespace minikin
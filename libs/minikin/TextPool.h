@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_TEXT_POOL_H
+#define MINIKIN_TEXT_POOL_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "minikin/Macros.h"
+#include "minikin/U16StringPiece.h"
+
+#include "SlabAllocator.h"
+
+namespace minikin {
+
+// Reference counted storage of UTF-16 strings in which identical strings are stored only once.
+// Short strings are allocated from slabs of a few size classes.
+//
+// This class is not thread-safe.
+class TextPool {
+public:
+    TextPool();
+    ~TextPool();
+
+    // Returns the pooled copy of the text and adds a reference to it. The hash must be computed
+    // from the text only.
+    const uint16_t* intern(const U16StringPiece& text, uint32_t hash);
+
+    // Removes a reference added by intern(). The copy is freed when no reference is left.
+    void release(const uint16_t* chars);
+
+    // Returns the number of distinct strings in the pool.
+    uint32_t size() const { return mCount; }
+
+private:
+    struct Block;
+
+    Block* allocateBlock(uint32_t length);
+    void freeBlock(Block* block);
+    void grow();
+
+    // Strings up to kSizeClassCount * kCharsPerSizeClass characters are allocated from slabs.
+    static const uint32_t kCharsPerSizeClass = 8;
+    static const uint32_t kSizeClassCount = 8;
+
+    // Chained hash table of the strings. The size is always a power of two.
+    std::vector<Block*> mBuckets;
+    uint32_t mCount;
+    std::vector<std::unique_ptr<SlabAllocator>> mSlabs;
+
+    MINIKIN_PREVENT_COPY_AND_ASSIGN(TextPool);
+};
+
+}  // namespace minikin
+
+#endif  // MINIKIN_TEXT_POOL_H
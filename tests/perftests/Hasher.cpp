@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/Hasher.h"
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "minikin/Macros.h"
+#include "minikin/Range.h"
+#include "minikin/U16StringPiece.h"
+
+namespace minikin {
+
+// The one-at-a-time Jenkins hash formerly used by Hasher, as the baseline.
+class JenkinsHasher {
+public:
+    JenkinsHasher() : mHash(0u) {}
+
+    IGNORE_INTEGER_OVERFLOW inline JenkinsHasher& update(uint32_t data) {
+        mHash += data;
+        mHash += (mHash << 10);
+        mHash ^= (mHash >> 6);
+        return *this;
+    }
+
+    inline JenkinsHasher& updateShorts(const uint16_t* data, uint32_t length) {
+        update(length);
+        uint32_t i;
+        for (i = 0; i < (length & -2); i += 2) {
+            update((uint32_t)data[i] | ((uint32_t)data[i + 1] << 16));
+        }
+        if (length & 1) {
+            update((uint32_t)data[i]);
+        }
+        return *this;
+    }
+
+    IGNORE_INTEGER_OVERFLOW inline uint32_t hash() {
+        uint32_t hash = mHash;
+        hash += (hash << 3);
+        hash ^= (hash >> 11);
+        hash += (hash << 15);
+        return hash;
+    }
+
+private:
+    uint32_t mHash;
+};
+
+// The argument is the length of the text, from short words to long pieces like URLs.
+template <typename H>
+static void BM_Hasher_updateShorts(benchmark::State& state) {
+    std::vector<uint16_t> text(state.range(0));
+    for (size_t i = 0; i < text.size(); ++i) {
+        text[i] = 'a' + i % 26;
+    }
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(H().updateShorts(text.data(), text.size()).hash());
+    }
+    state.SetBytesProcessed(state.iterations() * text.size() * sizeof(uint16_t));
+}
+BENCHMARK_TEMPLATE(BM_Hasher_updateShorts, Hasher)->RangeMultiplier(4)->Range(4, 1024);
+BENCHMARK_TEMPLATE(BM_Hasher_updateShorts, JenkinsHasher)->RangeMultiplier(4)->Range(4, 1024);
+
+// Hashes each word when it is looked up, as LayoutCacheKey does.
+class OnDemandTextHash {
+public:
+    explicit OnDemandTextHash(const U16StringPiece& text) : mText(text) {}
+
+    uint32_t hash(const Range& range) const {
+        const U16StringPiece word = mText.substr(range);
+        return Hasher().updateShorts(word.data(), word.size()).hash();
+    }
+
+private:
+    const U16StringPiece mText;
+};
+
+// The hashes of all the prefixes of the paragraph, from which the hash of a word is computed in
+// constant time. Passing such hashes to LayoutCache instead of hashing the words on demand was
+// declined: this costs about twice as much for a paragraph, because Hasher consumes eight
+// characters per multiplication while the prefixes take a multiplication and 16 bytes per
+// character.
+class PrefixTextHash {
+public:
+    IGNORE_INTEGER_OVERFLOW explicit PrefixTextHash(const U16StringPiece& text)
+            : mPrefixes(text.size() + 1), mPowers(text.size() + 1) {
+        mPrefixes[0] = 0;
+        mPowers[0] = 1;
+        for (uint32_t i = 0; i < text.size(); ++i) {
+            mPrefixes[i + 1] = mPrefixes[i] * kBase + text[i];
+            mPowers[i + 1] = mPowers[i] * kBase;
+        }
+    }
+
+    IGNORE_INTEGER_OVERFLOW uint32_t hash(const Range& range) const {
+        const uint64_t polynomial = mPrefixes[range.getEnd()] -
+                                    mPrefixes[range.getStart()] * mPowers[range.getLength()];
+        return Hasher()
+                .update(range.getLength())
+                .update(static_cast<uint32_t>(polynomial))
+                .update(static_cast<uint32_t>(polynomial >> 32))
+                .hash();
+    }
+
+private:
+    static constexpr uint64_t kBase = 0x9E3779B97F4A7C15ull;
+
+    std::vector<uint64_t> mPrefixes;
+    std::vector<uint64_t> mPowers;
+};
+
+// Hashes the words of a paragraph as measuring it does. The argument is the length of the
+// paragraph.
+template <typename T>
+static void BM_Hasher_paragraphWords(benchmark::State& state) {
+    std::vector<uint16_t> text(state.range(0));
+    std::vector<Range> words;
+    uint32_t start = 0;
+    for (uint32_t i = 0; i < text.size(); ++i) {
+        // Words of 1 to 10 letters.
+        if (i - start == (start * 7) % 10 + 1) {
+            text[i] = ' ';
+            words.push_back(Range(start, i + 1));
+            start = i + 1;
+        } else {
+            text[i] = 'a' + i % 26;
+        }
+    }
+    const U16StringPiece textBuf(text);
+    while (state.KeepRunning()) {
+        const T textHash(textBuf);
+        for (const Range& word : words) {
+            benchmark::DoNotOptimize(textHash.hash(word));
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * text.size() * sizeof(uint16_t));
+}
+BENCHMARK_TEMPLATE(BM_Hasher_paragraphWords, OnDemandTextHash)
+        ->RangeMultiplier(8)
+        ->Range(64, 4096);
+BENCHMARK_TEMPLATE(BM_Hasher_paragraphWords, PrefixTextHash)->RangeMultiplier(8)->Range(64, 4096);
+
+}  // namespace minikin
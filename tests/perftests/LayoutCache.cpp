@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/LayoutCache.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <utils/LruCache.h>
+
+#include "minikin/FontCollection.h"
+#include "minikin/MinikinPaint.h"
+
+#include "FontTestUtils.h"
+#include "UnicodeUtils.h"
+
+namespace minikin {
+
+// Defined in FontCollection.cpp.
+extern const char* SYSTEM_FONT_PATH;
+extern const char* SYSTEM_FONT_XML;
+
+// Number of distinct words looked up by the benchmarks. All of them fit in the cache.
+const int kVocabularySize = 1000;
+
+// Number of the words repeated by BM_LayoutCache_recentWordHit.
+const int kRecentWordCount = 16;
+
+// Roughly the number of words which fit in the caches used by the eviction benchmarks. Cycling
+// through the whole vocabulary makes every lookup of these benchmarks a miss, followed by an
+// insertion and an eviction.
+const uint32_t kChurnEntryCount = 100;
+
+struct Workload {
+    Workload() : paint(std::make_shared<FontCollection>(
+                         getFontFamilies(SYSTEM_FONT_PATH, SYSTEM_FONT_XML))) {
+        paint.size = 10.0f;
+        for (int i = 0; i < kVocabularySize; ++i) {
+            words.push_back(utf8ToUtf16("word" + std::to_string(i)));
+        }
+    }
+
+    MinikinPaint paint;
+    std::vector<std::vector<uint16_t>> words;
+};
+
+static Workload& getWorkload() {
+    static Workload workload;
+    return workload;
+}
+
+// A cache holding all the words of the vocabulary, so that the hit benchmarks only time lookups.
+class WarmLayoutCache : public LayoutCache {
+public:
+    WarmLayoutCache()
+            : LayoutCache(2 * 1024 * 1024 /* maxSizeInBytes */, 16 /* shardCount */,
+                          false /* useAdmissionFilter */, true /* useThreadCache */) {
+        Workload& workload = getWorkload();
+        for (const std::vector<uint16_t>& word : workload.words) {
+            U16StringPiece text(word);
+            getOrCreate(text, Range(0, text.size()), workload.paint, false,
+                        StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+        }
+    }
+};
+
+static LayoutCache& getWarmCache() {
+    static WarmLayoutCache* cache = new WarmLayoutCache();
+    return *cache;
+}
+
+// Used by android::LruCache.
+inline android::hash_t hash_type(const LayoutCacheKey& key) {
+    return key.hash();
+}
+
+// Makes the key point to its own copy of the text, so that it can be kept by the cache.
+static void copyText(LayoutCacheKey* key) {
+    const U16StringPiece text = key->text();
+    uint16_t* chars = new uint16_t[text.size()];
+    std::copy(text.data(), text.data() + text.size(), chars);
+    key->setTextStorage(chars);
+}
+
+// Frees the text copied by copyText().
+static void freeText(const LayoutCacheKey& key) {
+    delete[] key.text().data();
+}
+
+// A replica of the former design of LayoutCache, i.e. an android::LruCache guarded by a single
+// mutex, used as the baseline of the sharded table of LayoutCache.
+class LockedLruCache
+        : private android::OnEntryRemoved<LayoutCacheKey, std::shared_ptr<const LayoutPiece>> {
+public:
+    explicit LockedLruCache(uint32_t maxEntries) : mCache(maxEntries) {
+        mCache.setOnEntryRemovedListener(this);
+    }
+
+    ~LockedLruCache() { mCache.clear(); }
+
+    std::shared_ptr<const LayoutPiece> getOrCreate(const U16StringPiece& text, const Range& range,
+                                                   const MinikinPaint& paint) {
+        LayoutCacheKey key(text, range, paint, false, StartHyphenEdit::NO_EDIT,
+                           EndHyphenEdit::NO_EDIT);
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::shared_ptr<const LayoutPiece> layout = mCache.get(key);
+        if (layout == nullptr) {
+            copyText(&key);
+            layout = std::make_shared<LayoutPiece>(text, range, false, paint,
+                                                   StartHyphenEdit::NO_EDIT,
+                                                   EndHyphenEdit::NO_EDIT);
+            mCache.put(key, layout);
+        }
+        return layout;
+    }
+
+private:
+    void operator()(LayoutCacheKey& key, std::shared_ptr<const LayoutPiece>&) override {
+        freeText(key);
+    }
+
+    std::mutex mMutex;
+    android::LruCache<LayoutCacheKey, std::shared_ptr<const LayoutPiece>> mCache
+            GUARDED_BY(mMutex);
+};
+
+static void BM_LayoutCache_hit(benchmark::State& state) {
+    Workload& workload = getWorkload();
+    LayoutCache& cache = getWarmCache();
+    const uint64_t missCount = cache.getMissCount();
+    size_t i = state.thread_index;
+    while (state.KeepRunning()) {
+        const std::vector<uint16_t>& word = workload.words[i++ % workload.words.size()];
+        U16StringPiece text(word);
+        benchmark::DoNotOptimize(cache.getOrCreate(text, Range(0, text.size()), workload.paint,
+                                                   false, StartHyphenEdit::NO_EDIT,
+                                                   EndHyphenEdit::NO_EDIT));
+    }
+    if (cache.getMissCount() != missCount) {
+        state.SkipWithError("Words were laid out while timing lookups");
+    }
+}
+BENCHMARK(BM_LayoutCache_hit)->ThreadRange(1, 16);
+
+// The baseline cache, holding all the words of the vocabulary like the one of BM_LayoutCache_hit.
+static LockedLruCache& getWarmLockedLruCache() {
+    static LockedLruCache* cache = [] {
+        LockedLruCache* cache = new LockedLruCache(kVocabularySize);
+        Workload& workload = getWorkload();
+        for (const std::vector<uint16_t>& word : workload.words) {
+            U16StringPiece text(word);
+            cache->getOrCreate(text, Range(0, text.size()), workload.paint);
+        }
+        return cache;
+    }();
+    return *cache;
+}
+
+static void BM_LayoutCache_lockedLruHit(benchmark::State& state) {
+    Workload& workload = getWorkload();
+    LockedLruCache& cache = getWarmLockedLruCache();
+    size_t i = state.thread_index;
+    while (state.KeepRunning()) {
+        const std::vector<uint16_t>& word = workload.words[i++ % workload.words.size()];
+        U16StringPiece text(word);
+        benchmark::DoNotOptimize(cache.getOrCreate(text, Range(0, text.size()), workload.paint));
+    }
+}
+BENCHMARK(BM_LayoutCache_lockedLruHit)->ThreadRange(1, 16);
+
+struct AdvanceSum {
+    void operator()(const LayoutPiece& layout, const MinikinPaint&) { advance += layout.advance(); }
+
+    float advance = 0;
+};
+
+// Each thread repeats a few words, which are served by the cache of the thread. Unlike
+// BM_LayoutCache_hit, no handle is copied, as in Layout.
+static void BM_LayoutCache_recentWordHit(benchmark::State& state) {
+    Workload& workload = getWorkload();
+    LayoutCache& cache = getWarmCache();
+    AdvanceSum sum;
+    size_t i = state.thread_index;
+    while (state.KeepRunning()) {
+        const std::vector<uint16_t>& word = workload.words[i++ % kRecentWordCount];
+        U16StringPiece text(word);
+        cache.getOrCreate(text, Range(0, text.size()), workload.paint, false,
+                          StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, sum);
+    }
+    benchmark::DoNotOptimize(sum.advance);
+}
+BENCHMARK(BM_LayoutCache_recentWordHit)->ThreadRange(1, 16);
+
+// A cache which holds about kChurnEntryCount words and caches every new word, so that each miss
+// evicts an entry.
+class ChurnLayoutCache : public LayoutCache {
+public:
+    ChurnLayoutCache()
+            : LayoutCache(kChurnEntryCount * 256 /* maxSizeInBytes */, 1 /* shardCount */,
+                          false /* useAdmissionFilter */) {}
+};
+
+// Every iteration misses. The layout is done on every iteration of the eviction benchmarks, as
+// in the baseline, so the difference between the two is the cost of the lookup, the insertion and
+// the eviction.
+static void BM_LayoutCache_insertEvict(benchmark::State& state) {
+    static ChurnLayoutCache cache;
+    Workload& workload = getWorkload();
+    size_t i = state.thread_index;
+    while (state.KeepRunning()) {
+        const std::vector<uint16_t>& word = workload.words[i++ % workload.words.size()];
+        U16StringPiece text(word);
+        benchmark::DoNotOptimize(cache.getOrCreate(text, Range(0, text.size()), workload.paint,
+                                                   false, StartHyphenEdit::NO_EDIT,
+                                                   EndHyphenEdit::NO_EDIT));
+    }
+}
+BENCHMARK(BM_LayoutCache_insertEvict)->ThreadRange(1, 16);
+
+static void BM_LayoutCache_lockedLruInsertEvict(benchmark::State& state) {
+    static LockedLruCache cache(kChurnEntryCount);
+    Workload& workload = getWorkload();
+    size_t i = state.thread_index;
+    while (state.KeepRunning()) {
+        const std::vector<uint16_t>& word = workload.words[i++ % workload.words.size()];
+        U16StringPiece text(word);
+        benchmark::DoNotOptimize(cache.getOrCreate(text, Range(0, text.size()), workload.paint));
+    }
+}
+BENCHMARK(BM_LayoutCache_lockedLruInsertEvict)->ThreadRange(1, 16);
+
+}  // namespace minikin
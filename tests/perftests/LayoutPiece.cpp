@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/LayoutCore.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "minikin/FontCollection.h"
+#include "minikin/HbUtils.h"
+#include "minikin/Layout.h"
+#include "minikin/LayoutCache.h"
+#include "minikin/MinikinPaint.h"
+
+#include "FontTestUtils.h"
+#include "HbFontCache.h"
+#include "MinikinInternal.h"
+#include "UnicodeUtils.h"
+
+namespace minikin {
+
+// Defined in FontCollection.cpp.
+extern const char* SYSTEM_FONT_PATH;
+extern const char* SYSTEM_FONT_XML;
+
+static const char* kWords[] = {"a", "the", "layout", "cache", "international", "Hello,", "world."};
+
+static MinikinPaint buildPaint() {
+    MinikinPaint paint(
+            std::make_shared<FontCollection>(getFontFamilies(SYSTEM_FONT_PATH, SYSTEM_FONT_XML)));
+    paint.size = 10.0f;
+    return paint;
+}
+
+static std::vector<std::vector<uint16_t>> buildWords() {
+    std::vector<std::vector<uint16_t>> words;
+    for (const char* word : kWords) {
+        words.push_back(utf8ToUtf16(word));
+    }
+    return words;
+}
+
+// Reports the bytes held by the cache for each word, as counted against the cache budget. The
+// argument selects the layouts done with advancesOnly, as for measuring text.
+static void BM_LayoutPiece_memoryUsage(benchmark::State& state) {
+    const MinikinPaint paint = buildPaint();
+    const std::vector<std::vector<uint16_t>> words = buildWords();
+    const bool advancesOnly = state.range(0) != 0;
+    uint64_t totalBytes = 0;
+    uint64_t wordCount = 0;
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        const std::vector<uint16_t>& word = words[i++ % words.size()];
+        LayoutPiece layout(word, Range(0, word.size()), false /* LTR */, paint,
+                           StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT,
+                           false /* keepGlyphInfo */, advancesOnly);
+        totalBytes += layout.getMemoryUsage();
+        wordCount++;
+    }
+    state.counters["bytesPerWord"] = static_cast<double>(totalBytes) / wordCount;
+}
+BENCHMARK(BM_LayoutPiece_memoryUsage)->Arg(0)->Arg(1);
+
+// Lays out words without the LayoutCache, as on a cache miss. The argument purges the caches
+// before each word, so that the bounds of its glyphs are measured by the font again.
+static void BM_LayoutPiece_create(benchmark::State& state) {
+    const MinikinPaint paint = buildPaint();
+    const std::vector<std::vector<uint16_t>> words = buildWords();
+    const bool purge = state.range(0) != 0;
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        if (purge) {
+            state.PauseTiming();
+            Layout::purgeCaches();
+            state.ResumeTiming();
+        }
+        const std::vector<uint16_t>& word = words[i++ % words.size()];
+        LayoutPiece layout(word, Range(0, word.size()), false /* LTR */, paint,
+                           StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+        benchmark::DoNotOptimize(layout.bounds());
+    }
+}
+BENCHMARK(BM_LayoutPiece_create)->Arg(0)->Arg(1);
+
+static FakedFont getFirstFont(const MinikinPaint& paint) {
+    return paint.font->getFamilyAt(0)->getClosestMatch(paint.fontStyle);
+}
+
+struct PerPieceFontArguments {
+    const MinikinFont* font;
+    const MinikinPaint* paint;
+    FontFakery fakery;
+};
+
+// Sets up the HarfBuzz objects a word of a single font is shaped with, as the layouts did before
+// HbFontCache: a buffer and a sub-font with a heap allocated argument for the font functions were
+// created for every piece, and the CBDT table was looked up for each run. The difference with
+// BM_LayoutPiece_hbObjectsCached is what each cache-miss layout of BM_LayoutPiece_create saves.
+static void BM_LayoutPiece_hbObjectsPerPiece(benchmark::State& state) {
+    const MinikinPaint paint = buildPaint();
+    const FakedFont font = getFirstFont(paint);
+    static hb_font_funcs_t* fontFuncs = [] {
+        hb_font_funcs_t* funcs = hb_font_funcs_create();
+        hb_font_funcs_make_immutable(funcs);
+        return funcs;
+    }();
+    while (state.KeepRunning()) {
+        HbBufferUniquePtr buffer(hb_buffer_create());
+        HbFontUniquePtr hbFont(hb_font_create_sub_font(font.font->baseFont().get()));
+        const HbBlob cbdt(hbFont, HB_TAG('C', 'B', 'D', 'T'));
+        hb_font_set_funcs(hbFont.get(), fontFuncs,
+                          new PerPieceFontArguments{font.font->typeface().get(), &paint,
+                                                    font.fakery},
+                          [](void* data) {
+                              delete reinterpret_cast<PerPieceFontArguments*>(data);
+                          });
+        hb_font_set_ppem(hbFont.get(), paint.size * paint.scaleX, paint.size);
+        hb_font_set_scale(hbFont.get(), HBFloatToFixed(paint.size * paint.scaleX),
+                          HBFloatToFixed(paint.size));
+        benchmark::DoNotOptimize(buffer.get());
+        benchmark::DoNotOptimize(hbFont.get());
+        benchmark::DoNotOptimize(cbdt.get());
+    }
+}
+BENCHMARK(BM_LayoutPiece_hbObjectsPerPiece);
+
+// The same objects with HbFontCache and a buffer reused by the thread, as LayoutPiece does.
+static void BM_LayoutPiece_hbObjectsCached(benchmark::State& state) {
+    const MinikinPaint paint = buildPaint();
+    const FakedFont font = getFirstFont(paint);
+    HbBufferUniquePtr buffer(hb_buffer_create());
+    while (state.KeepRunning()) {
+        bool isColorBitmapFont;
+        HbFontUniquePtr hbFont = HbFontCache::getInstance().get(font, paint, &isColorBitmapFont);
+        hb_buffer_clear_contents(buffer.get());
+        benchmark::DoNotOptimize(buffer.get());
+        benchmark::DoNotOptimize(hbFont.get());
+        benchmark::DoNotOptimize(isColorBitmapFont);
+    }
+}
+BENCHMARK(BM_LayoutPiece_hbObjectsCached);
+
+struct AdvancesCopy {
+    void operator()(const LayoutPiece& layout, const MinikinPaint&) {
+        const Span<const float> advances = layout.advances();
+        std::copy(advances.begin(), advances.end(), out);
+    }
+
+    float out[32];
+};
+
+// A cache hit which copies the advances into the caller's array, as Layout and MeasuredText do.
+static void BM_LayoutPiece_hitCopyAdvances(benchmark::State& state) {
+    const MinikinPaint paint = buildPaint();
+    const std::vector<std::vector<uint16_t>> words = buildWords();
+    LayoutCache& cache = LayoutCache::getInstance();
+    AdvancesCopy copy;
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        const std::vector<uint16_t>& word = words[i++ % words.size()];
+        cache.getOrCreate(word, Range(0, word.size()), paint, false /* LTR */,
+                          StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, copy);
+    }
+    benchmark::DoNotOptimize(copy.out[0]);
+}
+BENCHMARK(BM_LayoutPiece_hitCopyAdvances);
+
+struct AdvancesVectorCopy {
+    void operator()(const LayoutPiece& layout, const MinikinPaint&) {
+        const Span<const float> advances = layout.advances();
+        std::vector<float> copy(advances.begin(), advances.end());
+        std::copy(copy.begin(), copy.end(), out);
+    }
+
+    float out[32];
+};
+
+// The same hit with the intermediate vector the accessors used to return, as the baseline.
+static void BM_LayoutPiece_hitCopyAdvancesViaVector(benchmark::State& state) {
+    const MinikinPaint paint = buildPaint();
+    const std::vector<std::vector<uint16_t>> words = buildWords();
+    LayoutCache& cache = LayoutCache::getInstance();
+    AdvancesVectorCopy copy;
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        const std::vector<uint16_t>& word = words[i++ % words.size()];
+        cache.getOrCreate(word, Range(0, word.size()), paint, false /* LTR */,
+                          StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, copy);
+    }
+    benchmark::DoNotOptimize(copy.out[0]);
+}
+BENCHMARK(BM_LayoutPiece_hitCopyAdvancesViaVector);
+
+}  // namespace minikin
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/LayoutCache.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "minikin/MinikinPaint.h"
+
+#include "FontTestUtils.h"
+#include "UnicodeUtils.h"
+
+namespace minikin {
+
+constexpr int VOCABULARY_SIZE = 5000;
+constexpr int STREAM_LENGTH = 200000;
+constexpr int WORDS_PER_SCREEN = 200;
+constexpr size_t HIT_RATIO_CACHE_SIZE_IN_BYTES = 128 * 1024;
+
+class PolicyLayoutCache : public LayoutCache {
+public:
+    PolicyLayoutCache(size_t maxSizeInBytes, bool useAdmissionFilter)
+            : LayoutCache(maxSizeInBytes, 1, useAdmissionFilter) {}
+};
+
+// Generates a stream which alternates between screens of frequently used words, following
+// Zipf's law, and screens of a long document where most words are seen only once.
+static std::vector<std::vector<uint16_t>> generateWordStream() {
+    std::mt19937 mt(0);
+    std::vector<double> weights;
+    for (int i = 1; i <= VOCABULARY_SIZE; ++i) {
+        weights.push_back(1.0 / i);
+    }
+    std::discrete_distribution<int> zipf(weights.begin(), weights.end());
+
+    std::vector<std::vector<uint16_t>> stream;
+    stream.reserve(STREAM_LENGTH);
+    int uniqueWordCount = 0;
+    while (stream.size() < STREAM_LENGTH) {
+        const bool isDocument = (stream.size() / WORDS_PER_SCREEN) % 2 == 1;
+        for (int i = 0; i < WORDS_PER_SCREEN; ++i) {
+            if (isDocument) {
+                stream.push_back(utf8ToUtf16("unique" + std::to_string(uniqueWordCount++)));
+            } else {
+                stream.push_back(utf8ToUtf16("word" + std::to_string(zipf(mt))));
+            }
+        }
+    }
+    return stream;
+}
+
+static double replay(const std::vector<std::vector<uint16_t>>& stream, const MinikinPaint& paint,
+                     bool useAdmissionFilter) {
+    PolicyLayoutCache cache(HIT_RATIO_CACHE_SIZE_IN_BYTES, useAdmissionFilter);
+    for (const auto& word : stream) {
+        cache.getOrCreate(word, Range(0, word.size()), paint, false /* LTR */,
+                          StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+    }
+    return 1.0 - static_cast<double>(cache.getMissCount()) / stream.size();
+}
+
+TEST(LayoutCacheHitRatioTest, AdmissionFilter) {
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+    paint.size = 10.0f;
+
+    const std::vector<std::vector<uint16_t>> stream = generateWordStream();
+    const double withoutFilter = replay(stream, paint, false /* useAdmissionFilter */);
+    const double withFilter = replay(stream, paint, true /* useAdmissionFilter */);
+    printf("LayoutCache hit ratio without admission filter: %.2f%%\n", withoutFilter * 100);
+    printf("LayoutCache hit ratio with admission filter:    %.2f%%\n", withFilter * 100);
+    EXPECT_LT(withoutFilter, withFilter);
+}
+
+}  // namespace minikin
@@ -16,7 +16,9 @@
 
 #include "minikin/Layout.h"
 
+#include <chrono>
 #include <condition_variable>
+#include <cstdio>
 #include <mutex>
 #include <random>
 #include <thread>
@@ -25,6 +27,7 @@
 #include <gtest/gtest.h>
 
 #include "minikin/FontCollection.h"
+#include "minikin/LayoutCache.h"
 #include "minikin/Macros.h"
 #include "minikin/MinikinPaint.h"
 
@@ -104,4 +107,86 @@ TEST(MultithreadTest, ThreadSafeStressTest) {
     }
 }
 
+constexpr int CACHE_LOOKUPS_PER_THREAD = 200000;
+constexpr int CACHE_VOCABULARY_SIZE = 2000;
+constexpr size_t CACHE_SIZE_IN_BYTES = 4 * 1024 * 1024;  // Large enough for the vocabulary.
+
+class ShardedLayoutCache : public LayoutCache {
+public:
+    ShardedLayoutCache(size_t maxSizeInBytes, uint32_t shardCount)
+            : LayoutCache(maxSizeInBytes, shardCount) {}
+};
+
+class AdvanceAccumulator {
+public:
+    void operator()(const LayoutPiece& layout, const MinikinPaint& /* paint */) {
+        mAdvance += layout.advance();
+    }
+
+    float mAdvance = 0;
+};
+
+// Returns the number of cache lookups per second done by threadCount threads on a warm cache.
+static double measureCacheThroughput(LayoutCache* cache, const MinikinPaint& paint,
+                                     const std::vector<std::vector<uint16_t>>& words,
+                                     int threadCount) {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool ready = false;
+
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount);
+    for (int i = 0; i < threadCount; ++i) {
+        threads.emplace_back([&, i] {
+            std::mt19937 mt(i);
+            std::uniform_int_distribution<size_t> dist(0, words.size() - 1);
+            AdvanceAccumulator f;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&] { return ready; });
+            }
+            for (int j = 0; j < CACHE_LOOKUPS_PER_THREAD; ++j) {
+                const std::vector<uint16_t>& word = words[dist(mt)];
+                cache->getOrCreate(word, Range(0, word.size()), paint, false /* LTR */,
+                                   StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, f);
+            }
+            LOG_ALWAYS_FATAL_IF(f.mAdvance <= 0, "Unexpected layout result.");
+        });
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready = true;
+    }
+    cv.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return threadCount * CACHE_LOOKUPS_PER_THREAD / elapsed.count();
+}
+
+TEST(MultithreadTest, LayoutCacheShardingBenchmark) {
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+    paint.size = 10.0f;
+
+    std::mt19937 mt(0);
+    std::vector<std::vector<uint16_t>> words;
+    words.reserve(CACHE_VOCABULARY_SIZE);
+    for (int i = 0; i < CACHE_VOCABULARY_SIZE; ++i) {
+        words.push_back(generateTestText(&mt, 5, 1));
+    }
+
+    for (uint32_t shardCount : {1u, 16u}) {
+        ShardedLayoutCache cache(CACHE_SIZE_IN_BYTES, shardCount);
+        measureCacheThroughput(&cache, paint, words, 1);  // Warm up the cache.
+        for (int threadCount : {1, 2, 4, 8, 16}) {
+            const double lookupsPerSec = measureCacheThroughput(&cache, paint, words, threadCount);
+            printf("LayoutCache shards=%2u threads=%2d: %12.0f lookups/sec\n", shardCount,
+                   threadCount, lookupsPerSec);
+        }
+    }
+}
+
 }  // namespace minikin
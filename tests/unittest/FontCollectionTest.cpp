@@ -175,4 +175,15 @@ TEST(FontCollectionTest, createWithVariations) {
     }
 }
 
+TEST(FontCollectionTest, fingerprintTest) {
+    std::shared_ptr<FontCollection> fc1 = buildFontCollection("Ascii.ttf");
+    std::shared_ptr<FontCollection> fc2 = buildFontCollection("Ascii.ttf");
+    std::shared_ptr<FontCollection> fc3 = buildFontCollection("Emoji.ttf");
+
+    // Unlike the ID, the fingerprint only depends on the fonts.
+    EXPECT_NE(fc1->getId(), fc2->getId());
+    EXPECT_EQ(fc1->getFingerprint(), fc2->getFingerprint());
+    EXPECT_NE(fc1->getFingerprint(), fc3->getFingerprint());
+}
+
 }  // namespace minikin
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/FontFeatureSettings.h"
+
+#include <gtest/gtest.h>
+
+#include "FontFeatureCache.h"
+
+namespace minikin {
+
+class TestableFontFeatureCache : public FontFeatureCache {
+public:
+    explicit TestableFontFeatureCache(uint32_t maxSize) : FontFeatureCache(maxSize) {}
+
+    using FontFeatureCache::getByIdInternal;
+    using FontFeatureCache::getIdInternal;
+};
+
+TEST(FontFeatureCacheTest, getId) {
+    EXPECT_EQ(0u, registerFontFeatureSettings(""));
+    EXPECT_NE(0u, registerFontFeatureSettings("'tnum' on"));
+    EXPECT_NE(0u, registerFontFeatureSettings("'smcp', 'liga' off"));
+
+    EXPECT_EQ(FontFeatureCache::getId("'tnum' on"), FontFeatureCache::getId("'tnum' on"));
+    EXPECT_NE(FontFeatureCache::getId("'tnum' on"), FontFeatureCache::getId("'tnum' off"));
+
+    // Settings without any valid feature are the same as the empty settings.
+    EXPECT_EQ(0u, FontFeatureCache::getId("'tnum'[3:5]"));
+    EXPECT_EQ(0u, FontFeatureCache::getId(","));
+}
+
+TEST(FontFeatureCacheTest, getById) {
+    EXPECT_TRUE(FontFeatureCache::getById(0).empty());
+
+    const std::vector<hb_feature_t>& features =
+            FontFeatureCache::getById(FontFeatureCache::getId("'smcp', 'liga' off, 'kern'[1:2]"));
+    ASSERT_EQ(2u, features.size());
+    EXPECT_EQ(HB_TAG('s', 'm', 'c', 'p'), features[0].tag);
+    EXPECT_EQ(1u, features[0].value);
+    EXPECT_EQ(HB_TAG('l', 'i', 'g', 'a'), features[1].tag);
+    EXPECT_EQ(0u, features[1].value);
+}
+
+TEST(FontFeatureCacheTest, getByIdWithoutLigatures) {
+    const std::vector<hb_feature_t>& empty = FontFeatureCache::getById(0, true);
+    ASSERT_EQ(2u, empty.size());
+    EXPECT_EQ(HB_TAG('l', 'i', 'g', 'a'), empty[0].tag);
+    EXPECT_EQ(0u, empty[0].value);
+    EXPECT_EQ(HB_TAG('c', 'l', 'i', 'g'), empty[1].tag);
+    EXPECT_EQ(0u, empty[1].value);
+
+    const uint32_t id = FontFeatureCache::getId("'smcp'");
+    EXPECT_EQ(1u, FontFeatureCache::getById(id, false).size());
+    const std::vector<hb_feature_t>& features = FontFeatureCache::getById(id, true);
+    ASSERT_EQ(3u, features.size());
+    EXPECT_EQ(HB_TAG('s', 'm', 'c', 'p'), features[2].tag);
+}
+
+TEST(FontFeatureCacheTest, getString) {
+    EXPECT_EQ("", FontFeatureCache::getString(0));
+    EXPECT_EQ("'tnum' on", FontFeatureCache::getString(FontFeatureCache::getId("'tnum' on")));
+}
+
+TEST(FontFeatureCacheTest, limitTest) {
+    // The empty settings and three others.
+    TestableFontFeatureCache cache(4);
+    const uint32_t tnumId = cache.getIdInternal("'tnum'");
+    EXPECT_NE(FontFeatureCache::kUnregisteredId, tnumId);
+    EXPECT_NE(FontFeatureCache::kUnregisteredId, cache.getIdInternal("'smcp'"));
+    EXPECT_EQ(FontFeatureCache::kEmptyId, cache.getIdInternal("'tnum'[3:5]"));
+
+    // New settings aren't registered once the cache is full, unless they are empty.
+    EXPECT_EQ(FontFeatureCache::kUnregisteredId, cache.getIdInternal("'liga' off"));
+    EXPECT_EQ(FontFeatureCache::kUnregisteredId, cache.getIdInternal("'liga' off"));
+    EXPECT_EQ(FontFeatureCache::kEmptyId, cache.getIdInternal(","));
+
+    // The registered settings are still found.
+    EXPECT_EQ(tnumId, cache.getIdInternal("'tnum'"));
+    EXPECT_EQ(HB_TAG('t', 'n', 'u', 'm'), cache.getByIdInternal(tnumId, false)[0].tag);
+}
+
+TEST(FontFeatureCacheTest, parse) {
+    const std::vector<hb_feature_t> features =
+            FontFeatureCache::parse("'smcp', 'kern'[1:2]", false);
+    ASSERT_EQ(1u, features.size());
+    EXPECT_EQ(HB_TAG('s', 'm', 'c', 'p'), features[0].tag);
+
+    // The same features as the ones of the registered settings.
+    const std::vector<hb_feature_t> withoutLigatures = FontFeatureCache::parse("'smcp'", true);
+    const std::vector<hb_feature_t>& expected =
+            FontFeatureCache::getById(FontFeatureCache::getId("'smcp'"), true);
+    ASSERT_EQ(expected.size(), withoutLigatures.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(expected[i].tag, withoutLigatures[i].tag);
+        EXPECT_EQ(expected[i].value, withoutLigatures[i].value);
+    }
+}
+
+}  // namespace minikin
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FrequencySketch.h"
+
+#include <gtest/gtest.h>
+
+#include "minikin/Hasher.h"
+
+namespace minikin {
+
+static uint32_t hashOf(uint32_t value) {
+    return Hasher().update(value).hash();
+}
+
+TEST(FrequencySketchTest, incrementTest) {
+    FrequencySketch sketch(64);
+    EXPECT_EQ(0u, sketch.frequency(hashOf(1)));
+
+    sketch.increment(hashOf(1));
+    EXPECT_EQ(1u, sketch.frequency(hashOf(1)));
+    sketch.increment(hashOf(1));
+    sketch.increment(hashOf(1));
+    EXPECT_EQ(3u, sketch.frequency(hashOf(1)));
+    EXPECT_GE(3u, sketch.frequency(hashOf(2)));
+
+    sketch.clear();
+    EXPECT_EQ(0u, sketch.frequency(hashOf(1)));
+}
+
+TEST(FrequencySketchTest, saturationTest) {
+    FrequencySketch sketch(64);
+    for (uint32_t i = 0; i < FrequencySketch::kMaxFrequency * 2; ++i) {
+        sketch.increment(hashOf(1));
+    }
+    EXPECT_EQ(FrequencySketch::kMaxFrequency, sketch.frequency(hashOf(1)));
+}
+
+TEST(FrequencySketchTest, agingTest) {
+    FrequencySketch sketch(64);
+    for (int i = 0; i < 8; ++i) {
+        sketch.increment(hashOf(0));
+    }
+    EXPECT_EQ(8u, sketch.frequency(hashOf(0)));
+
+    // Enough distinct items to trigger the aging at least once.
+    for (uint32_t i = 1; i <= 64 * 10; ++i) {
+        sketch.increment(hashOf(i));
+    }
+    EXPECT_GT(8u, sketch.frequency(hashOf(0)));
+}
+
+TEST(FrequencySketchTest, ensureCapacityTest) {
+    FrequencySketch sketch(64);
+    sketch.increment(hashOf(1));
+
+    // Not narrowed.
+    sketch.ensureCapacity(16);
+    EXPECT_EQ(1u, sketch.frequency(hashOf(1)));
+
+    // Widened, losing the history.
+    sketch.ensureCapacity(1024);
+    EXPECT_EQ(0u, sketch.frequency(hashOf(1)));
+}
+
+TEST(FrequencySketchTest, distinctItemsTest) {
+    FrequencySketch sketch(1024);
+    for (uint32_t i = 0; i < 256; ++i) {
+        sketch.increment(hashOf(i));
+    }
+    // With the sketch sized for more items than inserted, collisions rarely inflate the count.
+    int overestimated = 0;
+    for (uint32_t i = 0; i < 256; ++i) {
+        EXPECT_LE(1u, sketch.frequency(hashOf(i)));
+        if (sketch.frequency(hashOf(i)) > 1) {
+            overestimated++;
+        }
+    }
+    EXPECT_GT(16, overestimated);
+}
+
+}  // namespace minikin
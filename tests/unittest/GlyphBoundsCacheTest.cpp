@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "GlyphBoundsCache.h"
+
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "minikin/FontCollection.h"
+#include "minikin/MinikinExtent.h"
+
+namespace minikin {
+
+namespace {
+
+class TestableGlyphBoundsCache : public GlyphBoundsCache {
+public:
+    explicit TestableGlyphBoundsCache(uint32_t maxGlyphCount) : GlyphBoundsCache(maxGlyphCount) {}
+};
+
+// A font whose glyphs are as wide as their IDs, counting how many glyphs it measures.
+class CountingFont : public MinikinFont {
+public:
+    CountingFont() : MinikinFont(0), boundsCount(0), batchCount(0) {}
+
+    float GetHorizontalAdvance(uint32_t glyphId, const MinikinPaint&,
+                               const FontFakery&) const override {
+        return glyphId;
+    }
+
+    void GetBounds(MinikinRect* bounds, uint32_t glyphId, const MinikinPaint& paint,
+                   const FontFakery& fakery) const override {
+        boundsCount++;
+        const float italic = fakery.isFakeItalic() ? 1.0f : 0.0f;
+        *bounds = MinikinRect(italic, -paint.size, glyphId * paint.scaleX + italic, 0);
+    }
+
+    void GetBoundsBatch(MinikinRect* outBounds, const uint16_t* glyphIds, uint32_t count,
+                        const MinikinPaint& paint, const FontFakery& fakery) const override {
+        batchCount++;
+        MinikinFont::GetBoundsBatch(outBounds, glyphIds, count, paint, fakery);
+    }
+
+    void GetFontExtent(MinikinExtent*, const MinikinPaint&, const FontFakery&) const override {}
+
+    const std::vector<FontVariation>& GetAxes() const override { return mAxes; }
+
+    mutable int boundsCount;
+    mutable int batchCount;
+
+private:
+    std::vector<FontVariation> mAxes;
+};
+
+MinikinPaint buildPaint(float size) {
+    MinikinPaint paint(std::shared_ptr<FontCollection>(nullptr));
+    paint.size = size;
+    paint.scaleX = 1.0f;
+    return paint;
+}
+
+}  // namespace
+
+TEST(GlyphBoundsCacheTest, cacheTest) {
+    TestableGlyphBoundsCache cache(1024);
+    auto font = std::make_shared<CountingFont>();
+    const MinikinPaint paint = buildPaint(10.0f);
+    const uint16_t glyphIds[] = {3, 5, 3, 7};
+    MinikinRect bounds[4];
+
+    cache.getBounds(font, paint, FontFakery(), glyphIds, 4, bounds);
+    EXPECT_EQ(MinikinRect(0, -10, 3, 0), bounds[0]);
+    EXPECT_EQ(MinikinRect(0, -10, 5, 0), bounds[1]);
+    EXPECT_EQ(MinikinRect(0, -10, 3, 0), bounds[2]);
+    EXPECT_EQ(MinikinRect(0, -10, 7, 0), bounds[3]);
+    // The repeated glyph is measured once, in a single batch.
+    EXPECT_EQ(3, font->boundsCount);
+    EXPECT_EQ(1, font->batchCount);
+    EXPECT_EQ(3u, cache.getGlyphCount());
+
+    // Only the glyph which is not cached yet is measured.
+    const uint16_t moreGlyphIds[] = {5, 9};
+    cache.getBounds(font, paint, FontFakery(), moreGlyphIds, 2, bounds);
+    EXPECT_EQ(MinikinRect(0, -10, 5, 0), bounds[0]);
+    EXPECT_EQ(MinikinRect(0, -10, 9, 0), bounds[1]);
+    EXPECT_EQ(4, font->boundsCount);
+    EXPECT_EQ(2, font->batchCount);
+
+    // A hit doesn't call the font at all.
+    cache.getBounds(font, paint, FontFakery(), glyphIds, 4, bounds);
+    EXPECT_EQ(4, font->boundsCount);
+    EXPECT_EQ(2, font->batchCount);
+    EXPECT_EQ(MinikinRect(0, -10, 7, 0), bounds[3]);
+}
+
+TEST(GlyphBoundsCacheTest, strikeTest) {
+    TestableGlyphBoundsCache cache(1024);
+    auto font = std::make_shared<CountingFont>();
+    auto otherFont = std::make_shared<CountingFont>();
+    const uint16_t glyphId = 4;
+    MinikinRect bounds;
+
+    cache.getBounds(font, buildPaint(10.0f), FontFakery(), &glyphId, 1, &bounds);
+    EXPECT_EQ(MinikinRect(0, -10, 4, 0), bounds);
+
+    // Each size, scaleX, fakery and font has its own bounds.
+    cache.getBounds(font, buildPaint(20.0f), FontFakery(), &glyphId, 1, &bounds);
+    EXPECT_EQ(MinikinRect(0, -20, 4, 0), bounds);
+
+    MinikinPaint scaledPaint = buildPaint(10.0f);
+    scaledPaint.scaleX = 2.0f;
+    cache.getBounds(font, scaledPaint, FontFakery(), &glyphId, 1, &bounds);
+    EXPECT_EQ(MinikinRect(0, -10, 8, 0), bounds);
+
+    cache.getBounds(font, buildPaint(10.0f), FontFakery(false, true), &glyphId, 1, &bounds);
+    EXPECT_EQ(MinikinRect(1, -10, 5, 0), bounds);
+    EXPECT_EQ(4, font->boundsCount);
+
+    cache.getBounds(otherFont, buildPaint(10.0f), FontFakery(), &glyphId, 1, &bounds);
+    EXPECT_EQ(MinikinRect(0, -10, 4, 0), bounds);
+    EXPECT_EQ(1, otherFont->boundsCount);
+
+    cache.getBounds(font, buildPaint(10.0f), FontFakery(), &glyphId, 1, &bounds);
+    EXPECT_EQ(4, font->boundsCount);
+    EXPECT_EQ(5u, cache.getGlyphCount());
+}
+
+TEST(GlyphBoundsCacheTest, limitTest) {
+    TestableGlyphBoundsCache cache(4);
+    auto font = std::make_shared<CountingFont>();
+    const MinikinPaint paint = buildPaint(10.0f);
+    const uint16_t glyphIds[] = {1, 2, 3, 4, 5};
+    MinikinRect bounds[5];
+
+    cache.getBounds(font, paint, FontFakery(), glyphIds, 3, bounds);
+    EXPECT_EQ(3u, cache.getGlyphCount());
+
+    // Going over the limit drops the cached glyphs.
+    cache.getBounds(font, paint, FontFakery(), glyphIds + 3, 2, bounds);
+    EXPECT_EQ(2u, cache.getGlyphCount());
+    EXPECT_EQ(MinikinRect(0, -10, 5, 0), bounds[1]);
+
+    cache.getBounds(font, paint, FontFakery(), glyphIds, 1, bounds);
+    EXPECT_EQ(6, font->boundsCount);
+
+    cache.clear();
+    EXPECT_EQ(0u, cache.getGlyphCount());
+}
+
+TEST(GlyphBoundsCacheTest, destructedFontTest) {
+    TestableGlyphBoundsCache cache(1024);
+    const MinikinPaint paint = buildPaint(10.0f);
+    const uint16_t glyphId = 4;
+    MinikinRect bounds;
+
+    // Allocate the fonts in the same storage, so that the second one has the address of the
+    // first one.
+    std::aligned_storage<sizeof(CountingFont), alignof(CountingFont)>::type storage;
+    auto noDelete = [](CountingFont* font) { font->~CountingFont(); };
+    {
+        std::shared_ptr<CountingFont> font(new (&storage) CountingFont(), noDelete);
+        cache.getBounds(font, paint, FontFakery(), &glyphId, 1, &bounds);
+        EXPECT_EQ(1, font->boundsCount);
+    }
+    std::shared_ptr<CountingFont> font(new (&storage) CountingFont(), noDelete);
+    cache.getBounds(font, paint, FontFakery(), &glyphId, 1, &bounds);
+    EXPECT_EQ(1, font->boundsCount);
+    EXPECT_EQ(1u, cache.getGlyphCount());
+}
+
+}  // namespace minikin
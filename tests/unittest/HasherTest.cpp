@@ -16,6 +16,10 @@
 
 #include "minikin/Hasher.h"
 
+#include <string>
+#include <unordered_set>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 namespace minikin {
@@ -35,4 +39,125 @@ TEST(HasherTest, hasherTest) {
     EXPECT_EQ(hasher.hash(), hasher.hash());
 }
 
+TEST(HasherTest, lengthAndOrderTest) {
+    uint16_t shorts[] = {1, 2, 0, 0};
+    EXPECT_NE(Hasher().updateShorts(shorts, 2).hash(), Hasher().updateShorts(shorts, 3).hash());
+    EXPECT_NE(Hasher().updateShorts(shorts, 3).hash(), Hasher().updateShorts(shorts, 4).hash());
+    EXPECT_NE(Hasher().update(1).update(2).hash(), Hasher().update(2).update(1).hash());
+    EXPECT_NE(Hasher().updateString("ab").updateString("c").hash(),
+              Hasher().updateString("a").updateString("bc").hash());
+    EXPECT_EQ(Hasher().updateString("abc").hash64(), Hasher().updateString("abc").hash64());
+}
+
+TEST(HasherTest, floatTest) {
+    // The fraction is hashed, unlike with update().
+    EXPECT_NE(Hasher().updateFloat(1.0f).hash(), Hasher().updateFloat(1.5f).hash());
+    EXPECT_NE(Hasher().updateFloat(-0.25f).hash(), Hasher().updateFloat(0.25f).hash());
+    EXPECT_EQ(Hasher().updateFloat(0.0f).hash(), Hasher().updateFloat(-0.0f).hash());
+}
+
+// Words of all the lengths hashed by LayoutCacheKey, most of them differing in a single
+// character from many others.
+static std::vector<std::u16string> buildCorpus() {
+    std::vector<std::u16string> corpus;
+    const std::u16string letters = u"etaoinshrdlucmfwypvbgkqjxz";
+    for (char16_t a : letters) {
+        corpus.push_back(std::u16string(1, a));
+        for (char16_t b : letters) {
+            corpus.push_back({a, b});
+            for (char16_t c : letters) {
+                corpus.push_back({a, b, c});
+                corpus.push_back({u'T', a, b, c, u'e', u'd'});
+            }
+        }
+    }
+    for (int i = 0; i < 50000; ++i) {
+        const std::string word = "word" + std::to_string(i);
+        corpus.push_back(std::u16string(word.begin(), word.end()));
+    }
+    // CJK and long texts, e.g. URLs.
+    for (char16_t c = 0x4E00; c < 0x4E00 + 2000; ++c) {
+        corpus.push_back({c, static_cast<char16_t>(c + 1)});
+        corpus.push_back(u"https://www.example.com/" + std::u16string(20, c));
+    }
+    return corpus;
+}
+
+TEST(HasherTest, collisionTest) {
+    const std::vector<std::u16string> corpus = buildCorpus();
+    std::unordered_set<uint32_t> hashes;
+    std::unordered_set<uint64_t> hashes64;
+    std::vector<uint32_t> lowBitCounts(1024);
+    for (const std::u16string& word : corpus) {
+        Hasher hasher;
+        hasher.updateShorts(reinterpret_cast<const uint16_t*>(word.data()), word.size());
+        const uint32_t hash = hasher.hash();
+        hashes.insert(hash);
+        hashes64.insert(hasher.hash64());
+        lowBitCounts[hash & 1023]++;
+    }
+
+    // No 64-bit collision at all, and about as few 32-bit collisions as a random function has,
+    // i.e. n^2 / 2^33, which is less than 2 for this corpus.
+    EXPECT_EQ(corpus.size(), hashes64.size());
+    EXPECT_GE(8u, corpus.size() - hashes.size());
+
+    // The low bits, which select the shard of LayoutCache and the slot of the thread caches, are
+    // evenly distributed.
+    const double mean = static_cast<double>(corpus.size()) / lowBitCounts.size();
+    for (uint32_t count : lowBitCounts) {
+        EXPECT_LT(mean * 0.5, count);
+        EXPECT_GT(mean * 1.5, count);
+    }
+}
+
+// The Thue-Morse sequence of 'a' and 'b', or of 'b' and 'a' if complemented. A polynomial modulo
+// 2^64 of a sequence and of its complement collide from 1024 characters, whatever the base.
+static std::u16string thueMorse(uint32_t length, bool complemented) {
+    std::u16string text(length, u'a');
+    for (uint32_t i = 0; i < length; ++i) {
+        if ((__builtin_popcount(i) % 2 == 1) != complemented) {
+            text[i] = u'b';
+        }
+    }
+    return text;
+}
+
+static uint32_t hashText(const std::u16string& text) {
+    return Hasher()
+            .updateShorts(reinterpret_cast<const uint16_t*>(text.data()), text.size())
+            .hash();
+}
+
+TEST(HasherTest, repeatedTextTest) {
+    EXPECT_NE(hashText(thueMorse(2048, false)), hashText(thueMorse(2048, true)));
+
+    // Texts of all the lengths up to a long paragraph, made of a repeated pattern or of the
+    // prefixes of the Thue-Morse sequence.
+    std::unordered_set<std::u16string> corpus;
+    const std::u16string patterns[] = {u"a", u"ab", u"abc", u"ab ", u"Hello, World. ",
+                                       u"\u0627\u0644", u"\u3042\u3044"};
+    const uint32_t kMaxLength = 2048;
+    for (const std::u16string& pattern : patterns) {
+        std::u16string text;
+        for (uint32_t i = 0; i < kMaxLength; ++i) {
+            text.push_back(pattern[i % pattern.size()]);
+            corpus.insert(text);
+        }
+    }
+    for (bool complemented : {false, true}) {
+        const std::u16string text = thueMorse(kMaxLength, complemented);
+        for (uint32_t length = 1; length <= kMaxLength; ++length) {
+            corpus.insert(text.substr(0, length));
+        }
+    }
+
+    // About 0.01 collisions of 32-bit hashes are expected from a random function.
+    std::unordered_set<uint32_t> hashes;
+    for (const std::u16string& text : corpus) {
+        hashes.insert(hashText(text));
+    }
+    EXPECT_GE(1u, corpus.size() - hashes.size());
+}
+
 }  // namespace minikin
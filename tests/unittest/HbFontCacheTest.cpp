@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "HbFontCache.h"
+
+#include <gtest/gtest.h>
+
+#include "minikin/FontCollection.h"
+
+#include "FontTestUtils.h"
+
+namespace minikin {
+
+namespace {
+
+class TestableHbFontCache : public HbFontCache {
+public:
+    explicit TestableHbFontCache(uint32_t maxSize) : HbFontCache(maxSize) {}
+};
+
+}  // namespace
+
+TEST(HbFontCacheTest, cacheTest) {
+    TestableHbFontCache cache(16);
+    auto collection = buildFontCollection("Ascii.ttf");
+    const FakedFont font = collection->baseFontFaked(FontStyle());
+    MinikinPaint paint(collection);
+    paint.size = 10.0f;
+    paint.scaleX = 1.0f;
+
+    bool isColorBitmapFont = true;
+    HbFontUniquePtr hbFont = cache.get(font, paint, &isColorBitmapFont);
+    EXPECT_FALSE(isColorBitmapFont);
+    EXPECT_NE(font.font->baseFont().get(), hbFont.get());
+
+    // The same font is returned for the same size, even to another paint.
+    MinikinPaint otherPaint = paint;
+    otherPaint.letterSpacing = 1.0f;
+    EXPECT_EQ(hbFont.get(), cache.get(font, otherPaint, &isColorBitmapFont).get());
+    EXPECT_EQ(1u, cache.getSize());
+
+    // Each size, scaleX and fakery has its own font.
+    paint.size = 20.0f;
+    EXPECT_NE(hbFont.get(), cache.get(font, paint, &isColorBitmapFont).get());
+    paint.scaleX = 2.0f;
+    EXPECT_NE(hbFont.get(), cache.get(font, paint, &isColorBitmapFont).get());
+    const FakedFont italicFont = {font.font, FontFakery(false, true)};
+    EXPECT_NE(hbFont.get(), cache.get(italicFont, otherPaint, &isColorBitmapFont).get());
+    EXPECT_EQ(4u, cache.getSize());
+
+    // The fonts stay usable after being dropped from the cache.
+    cache.clear();
+    EXPECT_EQ(0u, cache.getSize());
+    int xScale = 0;
+    hb_font_get_scale(hbFont.get(), &xScale, nullptr);
+    EXPECT_EQ(HBFloatToFixed(10.0f), xScale);
+}
+
+TEST(HbFontCacheTest, limitTest) {
+    TestableHbFontCache cache(2);
+    auto collection = buildFontCollection("Ascii.ttf");
+    const FakedFont font = collection->baseFontFaked(FontStyle());
+    MinikinPaint paint(collection);
+    bool isColorBitmapFont;
+    for (int i = 1; i <= 5; ++i) {
+        paint.size = i;
+        cache.get(font, paint, &isColorBitmapFont);
+        EXPECT_GE(2u, cache.getSize());
+    }
+}
+
+TEST(HbFontCacheTest, lruTest) {
+    TestableHbFontCache cache(2);
+    auto collection = buildFontCollection("Ascii.ttf");
+    const FakedFont font = collection->baseFontFaked(FontStyle());
+    MinikinPaint paint(collection);
+    bool isColorBitmapFont;
+    paint.size = 10.0f;
+    HbFontUniquePtr font10 = cache.get(font, paint, &isColorBitmapFont);
+    paint.size = 20.0f;
+    HbFontUniquePtr font20 = cache.get(font, paint, &isColorBitmapFont);
+
+    // The recently used font stays in the cache when another one is added.
+    paint.size = 10.0f;
+    EXPECT_EQ(font10.get(), cache.get(font, paint, &isColorBitmapFont).get());
+    paint.size = 30.0f;
+    cache.get(font, paint, &isColorBitmapFont);
+    EXPECT_EQ(2u, cache.getSize());
+    paint.size = 10.0f;
+    EXPECT_EQ(font10.get(), cache.get(font, paint, &isColorBitmapFont).get());
+    paint.size = 20.0f;
+    EXPECT_NE(font20.get(), cache.get(font, paint, &isColorBitmapFont).get());
+}
+
+TEST(HbFontCacheTest, fontOutlivesCollectionTest) {
+    TestableHbFontCache cache(16);
+    auto collection = buildFontCollection("Ascii.ttf");
+    MinikinPaint paint(collection);
+    paint.size = 10.0f;
+    bool isColorBitmapFont;
+    HbFontUniquePtr hbFont =
+            cache.get(collection->baseFontFaked(FontStyle()), paint, &isColorBitmapFont);
+    hb_codepoint_t glyph = 0;
+    ASSERT_TRUE(hb_font_get_nominal_glyph(hbFont.get(), 'a', &glyph));
+    const hb_position_t advance = hb_font_get_glyph_h_advance(hbFont.get(), glyph);
+
+    // The font still calls its MinikinFont after the collection and its fonts are destroyed.
+    paint.font.reset();
+    collection.reset();
+    EXPECT_EQ(advance, hb_font_get_glyph_h_advance(hbFont.get(), glyph));
+}
+
+}  // namespace minikin
@@ -16,11 +16,18 @@
 
 #include "minikin/Layout.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
 #include <gtest/gtest.h>
 
 #include "minikin/LayoutCache.h"
+#include "minikin/LocaleList.h"
 
 #include "FontTestUtils.h"
+#include "LayoutPaintCache.h"
 #include "LocaleListCache.h"
 #include "UnicodeUtils.h"
 
@@ -28,10 +35,18 @@ namespace minikin {
 
 class TestableLayoutCache : public LayoutCache {
 public:
-    TestableLayoutCache(uint32_t maxEntries) : LayoutCache(maxEntries) {}
+    TestableLayoutCache(size_t maxSizeInBytes, uint32_t shardCount = 1,
+                        bool useAdmissionFilter = true, bool useThreadCache = false)
+            : LayoutCache(maxSizeInBytes, shardCount, useAdmissionFilter, useThreadCache) {}
     using LayoutCache::getCacheSize;
+    using LayoutCache::getShardCount;
+
+    // The size of the entries of the default partition, without the unused memory of the slabs.
+    size_t getEntrySizeInBytes() { return getPartitionStats(kDefaultPartition).sizeInBytes; }
 };
 
+constexpr size_t kTestCacheSize = 1024 * 1024;
+
 class LayoutCapture {
 public:
     LayoutCapture() {}
@@ -49,7 +64,7 @@ TEST(LayoutCacheTest, cacheHitTest) {
     Range range(0, text.size());
     MinikinPaint paint(buildFontCollection("Ascii.ttf"));
 
-    TestableLayoutCache layoutCache(10);
+    TestableLayoutCache layoutCache(kTestCacheSize);
 
     LayoutCapture layout1;
     layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
@@ -67,7 +82,7 @@ TEST(LayoutCacheTest, cacheMissTest) {
     auto text2 = utf8ToUtf16("ANDROID");
     MinikinPaint paint(buildFontCollection("Ascii.ttf"));
 
-    TestableLayoutCache layoutCache(10);
+    TestableLayoutCache layoutCache(kTestCacheSize);
 
     LayoutCapture layout1;
     LayoutCapture layout2;
@@ -254,31 +269,658 @@ TEST(LayoutCacheTest, cacheOverflowTest) {
     Range range(0, text.size());
     MinikinPaint paint(buildFontCollection("Ascii.ttf"));
 
-    TestableLayoutCache layoutCache(5);
+    // Only a handful of 10 character words fit in this budget.
+    TestableLayoutCache layoutCache(2048);
 
     LayoutCapture layout1;
     layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
                             EndHyphenEdit::NO_EDIT, layout1);
 
+    // Each word is requested twice, so that it is more frequent than the word it replaces.
     for (char c = 'a'; c <= 'z'; c++) {
         auto text1 = utf8ToUtf16(std::string(10, c));
+        for (int i = 0; i < 2; ++i) {
+            LayoutCapture layout2;
+            layoutCache.getOrCreate(text1, Range(0, text1.size()), paint, false /* LTR */,
+                                    StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout2);
+        }
+    }
+
+    LayoutCapture layout3;
+    layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                            EndHyphenEdit::NO_EDIT, layout3);
+    EXPECT_NE(layout1.get(), layout3.get());
+}
+
+TEST(LayoutCacheTest, secondChanceTest) {
+    auto text = utf8ToUtf16("android");
+    Range range(0, text.size());
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+
+    TestableLayoutCache layoutCache(kTestCacheSize);
+    LayoutCapture layout1;
+    layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                            EndHyphenEdit::NO_EDIT, layout1);
+    layoutCache.setMaxSizeInBytes(layoutCache.getEntrySizeInBytes() * 4);
+
+    // A word which is hit between insertions is never chosen for eviction.
+    for (char c = 'a'; c <= 'z'; c++) {
+        auto text1 = utf8ToUtf16(std::string(7, c));
         LayoutCapture layout2;
         layoutCache.getOrCreate(text1, Range(0, text1.size()), paint, false /* LTR */,
                                 StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout2);
+
+        LayoutCapture layout3;
+        layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                                EndHyphenEdit::NO_EDIT, layout3);
+        EXPECT_EQ(layout1.get(), layout3.get());
+    }
+    EXPECT_GE(4u, layoutCache.getCacheSize());
+}
+
+// Returns how many of the hot words survive a scan of unique words.
+static int countSurvivorsOfScan(bool useAdmissionFilter) {
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+    TestableLayoutCache layoutCache(kTestCacheSize, 1, useAdmissionFilter);
+
+    std::vector<std::vector<uint16_t>> hotWords;
+    for (char c = 'a'; c < 'e'; c++) {
+        hotWords.push_back(utf8ToUtf16(std::string(7, c)));
+    }
+    std::vector<std::shared_ptr<const LayoutPiece>> hotLayouts;
+    for (int i = 0; i < 3; ++i) {
+        hotLayouts.clear();
+        for (const auto& word : hotWords) {
+            hotLayouts.push_back(layoutCache.getOrCreate(word, Range(0, word.size()), paint,
+                                                         false /* LTR */, StartHyphenEdit::NO_EDIT,
+                                                         EndHyphenEdit::NO_EDIT));
+        }
+    }
+    layoutCache.setMaxSizeInBytes(layoutCache.getEntrySizeInBytes() * 2);
+
+    for (int i = 0; i < 100; ++i) {
+        auto word = utf8ToUtf16("scan" + std::to_string(i));
+        layoutCache.getOrCreate(word, Range(0, word.size()), paint, false /* LTR */,
+                                StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+    }
+
+    int survivors = 0;
+    for (size_t i = 0; i < hotWords.size(); ++i) {
+        const auto& word = hotWords[i];
+        if (layoutCache.getOrCreate(word, Range(0, word.size()), paint, false /* LTR */,
+                                    StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT) ==
+            hotLayouts[i]) {
+            survivors++;
+        }
+    }
+    return survivors;
+}
+
+TEST(LayoutCacheTest, scanResistanceTest) {
+    // Words used many times are not flushed by words used only once.
+    EXPECT_EQ(4, countSurvivorsOfScan(true /* useAdmissionFilter */));
+    EXPECT_EQ(0, countSurvivorsOfScan(false /* useAdmissionFilter */));
+}
+
+TEST(LayoutCacheTest, missCountTest) {
+    auto text = utf8ToUtf16("android");
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+
+    TestableLayoutCache layoutCache(kTestCacheSize);
+    EXPECT_EQ(0u, layoutCache.getMissCount());
+    for (int i = 0; i < 3; ++i) {
+        layoutCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                                StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+    }
+    EXPECT_EQ(1u, layoutCache.getMissCount());
+}
+
+TEST(LayoutCacheTest, concurrentHitAndEvictTest) {
+    constexpr int kThreadCount = 4;
+    constexpr int kIterations = 2000;
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+
+    // Small enough that entries are evicted and tables are replaced while other threads read.
+    TestableLayoutCache layoutCache(4096, 2);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreadCount; ++i) {
+        threads.emplace_back([&, i] {
+            for (int j = 0; j < kIterations; ++j) {
+                auto text = utf8ToUtf16(std::to_string((i * 7 + j) % 64));
+                std::shared_ptr<const LayoutPiece> layout = layoutCache.getOrCreate(
+                        text, Range(0, text.size()), paint, false /* LTR */,
+                        StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+                EXPECT_EQ(text.size(), layout->advances().size());
+                if (j % 500 == 0) {
+                    layoutCache.clear();
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_GE(4096u, layoutCache.getEntrySizeInBytes());
+}
+
+TEST(LayoutCacheTest, cacheSizeInBytesTest) {
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+
+    TestableLayoutCache layoutCache(kTestCacheSize);
+    EXPECT_EQ(kTestCacheSize, layoutCache.getMaxSizeInBytes());
+    EXPECT_EQ(0u, layoutCache.getSizeInBytes());
+
+    auto text = utf8ToUtf16("android");
+    LayoutCapture layout;
+    layoutCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                            StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout);
+    const size_t entrySize = layoutCache.getEntrySizeInBytes();
+    EXPECT_LT(layout.get()->getMemoryUsage(), entrySize);
+    // The slab of the entries is counted too.
+    EXPECT_LT(entrySize, layoutCache.getSizeInBytes());
+
+    for (char c = 'a'; c <= 'z'; c++) {
+        auto text1 = utf8ToUtf16(std::string(10, c));
+        layoutCache.getOrCreate(text1, Range(0, text1.size()), paint, false /* LTR */,
+                                StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout);
+    }
+    EXPECT_EQ(27u, layoutCache.getCacheSize());
+
+    // Shrinking the budget evicts entries until the cache fits in it.
+    layoutCache.setMaxSizeInBytes(entrySize * 10);
+    EXPECT_EQ(entrySize * 10, layoutCache.getMaxSizeInBytes());
+    EXPECT_GE(entrySize * 10, layoutCache.getEntrySizeInBytes());
+    EXPECT_GT(27u, layoutCache.getCacheSize());
+
+    // The memory of the evicted entries is given back.
+    layoutCache.setMaxSizeInBytes(0);
+    EXPECT_EQ(0u, layoutCache.getCacheSize());
+    EXPECT_EQ(0u, layoutCache.getSizeInBytes());
+
+    // An entry larger than the whole budget is not kept.
+    layoutCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                            StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout);
+    EXPECT_EQ(0u, layoutCache.getCacheSize());
+}
+
+TEST(LayoutCacheTest, partitionTest) {
+    auto text = utf8ToUtf16("android");
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+
+    TestableLayoutCache layoutCache(kTestCacheSize);
+    std::shared_ptr<const LayoutPiece> layout = layoutCache.getOrCreate(
+            text, Range(0, text.size()), paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+            EndHyphenEdit::NO_EDIT);
+
+    // The words of the batch partition only evict each other.
+    MinikinPaint batchPaint(paint);
+    batchPaint.layoutCachePartition = layoutCache.createPartition("batch", 2048);
+    EXPECT_NE(LayoutCache::kDefaultPartition, batchPaint.layoutCachePartition);
+    EXPECT_EQ(batchPaint.layoutCachePartition, layoutCache.createPartition("batch", 2048));
+    for (int i = 0; i < 1000; ++i) {
+        auto word = utf8ToUtf16(std::to_string(i));
+        for (int j = 0; j < 2; ++j) {
+            layoutCache.getOrCreate(word, Range(0, word.size()), batchPaint, false /* LTR */,
+                                    StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+        }
+    }
+    EXPECT_GE(2048u, layoutCache.getPartitionStats(batchPaint.layoutCachePartition).sizeInBytes);
+    EXPECT_EQ(layout, layoutCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                                              StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT));
+
+    // Partitions don't share their layouts.
+    EXPECT_NE(layout,
+              layoutCache.getOrCreate(text, Range(0, text.size()), batchPaint, false /* LTR */,
+                                      StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT));
+
+    // An unknown partition is the default partition.
+    MinikinPaint unknownPaint(paint);
+    unknownPaint.layoutCachePartition = LayoutCache::kMaxPartitionCount;
+    EXPECT_EQ(layout,
+              layoutCache.getOrCreate(text, Range(0, text.size()), unknownPaint, false /* LTR */,
+                                      StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT));
+}
+
+TEST(LayoutCacheTest, pinnedPartitionTest) {
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+
+    TestableLayoutCache layoutCache(kTestCacheSize);
+    paint.layoutCachePartition = layoutCache.createPartition("chrome", 2048, true /* pinned */);
+
+    std::vector<std::shared_ptr<const LayoutPiece>> layouts;
+    for (int i = 0; i < 100; ++i) {
+        auto word = utf8ToUtf16(std::to_string(i));
+        layouts.push_back(layoutCache.getOrCreate(word, Range(0, word.size()), paint,
+                                                  false /* LTR */, StartHyphenEdit::NO_EDIT,
+                                                  EndHyphenEdit::NO_EDIT));
+    }
+    const LayoutCache::PartitionStats stats =
+            layoutCache.getPartitionStats(paint.layoutCachePartition);
+    EXPECT_LT(0u, stats.entryCount);
+    EXPECT_GT(100u, stats.entryCount);
+    EXPECT_GE(2048u, stats.sizeInBytes);
+
+    // The first words stay in the cache however often the other words are requested, since the
+    // pinned partition doesn't evict anything.
+    for (int j = 0; j < 3; ++j) {
+        for (int i = 0; i < 100; ++i) {
+            auto word = utf8ToUtf16(std::to_string(i));
+            std::shared_ptr<const LayoutPiece> layout = layoutCache.getOrCreate(
+                    word, Range(0, word.size()), paint, false /* LTR */,
+                    StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+            EXPECT_EQ(i < static_cast<int>(stats.entryCount), layout == layouts[i]);
+        }
+    }
+    EXPECT_EQ(stats.entryCount,
+              layoutCache.getPartitionStats(paint.layoutCachePartition).entryCount);
+
+    layoutCache.clear();
+    EXPECT_EQ(0u, layoutCache.getPartitionStats(paint.layoutCachePartition).entryCount);
+}
+
+TEST(LayoutCacheTest, partitionStatsTest) {
+    auto text = utf8ToUtf16("android");
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+
+    for (bool useThreadCache : {false, true}) {
+        SCOPED_TRACE(useThreadCache ? "With thread cache" : "Without thread cache");
+        TestableLayoutCache layoutCache(kTestCacheSize, 1, true /* useAdmissionFilter */,
+                                        useThreadCache);
+        MinikinPaint uiPaint(paint);
+        uiPaint.layoutCachePartition = layoutCache.createPartition("ui", 4096);
+        for (int i = 0; i < 3; ++i) {
+            layoutCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                                    StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+        }
+        layoutCache.getOrCreate(text, Range(0, text.size()), uiPaint, false /* LTR */,
+                                StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+
+        LayoutCache::PartitionStats stats =
+                layoutCache.getPartitionStats(LayoutCache::kDefaultPartition);
+        EXPECT_EQ(2u, stats.hitCount);
+        EXPECT_EQ(1u, stats.missCount);
+        EXPECT_EQ(1u, stats.entryCount);
+        EXPECT_EQ(kTestCacheSize, stats.maxSizeInBytes);
+
+        stats = layoutCache.getPartitionStats(uiPaint.layoutCachePartition);
+        EXPECT_EQ(0u, stats.hitCount);
+        EXPECT_EQ(1u, stats.missCount);
+        EXPECT_EQ(1u, stats.entryCount);
+        EXPECT_EQ(4096u, stats.maxSizeInBytes);
+        EXPECT_LT(0u, stats.sizeInBytes);
+
+        EXPECT_EQ(2u, layoutCache.getMissCount());
+    }
+}
+
+TEST(LayoutCacheTest, concurrentMissTest) {
+    constexpr int kThreadCount = 8;
+    auto text = utf8ToUtf16("android");
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+
+    TestableLayoutCache layoutCache(kTestCacheSize);
+
+    std::vector<LayoutCapture> layouts(kThreadCount);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreadCount; ++i) {
+        threads.emplace_back([&, i] {
+            layoutCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                                    StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layouts[i]);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // The layout is done only once, and all the threads receive the same result either from the
+    // cache or by waiting for the thread doing the layout.
+    for (int i = 1; i < kThreadCount; ++i) {
+        EXPECT_EQ(layouts[0].get(), layouts[i].get());
+    }
+    EXPECT_EQ(1u, layoutCache.getCacheSize());
+    EXPECT_GT(static_cast<uint64_t>(kThreadCount), layoutCache.getDeduplicatedLayoutCount());
+}
+
+TEST(LayoutCacheTest, layoutHandleTest) {
+    auto text = utf8ToUtf16("android");
+    Range range(0, text.size());
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+
+    TestableLayoutCache layoutCache(kTestCacheSize);
+
+    std::shared_ptr<const LayoutPiece> layout1 = layoutCache.getOrCreate(
+            text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+    std::shared_ptr<const LayoutPiece> layout2 = layoutCache.getOrCreate(
+            text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+    EXPECT_EQ(layout1.get(), layout2.get());
+
+    // The handle keeps the layout alive after it is evicted from the cache.
+    const std::vector<float> advances(layout1->advances().begin(), layout1->advances().end());
+    layoutCache.clear();
+    EXPECT_EQ(0u, layoutCache.getCacheSize());
+    EXPECT_EQ(text.size(), layout1->advances().size());
+    EXPECT_EQ(Span<const float>(advances), layout1->advances());
+}
+
+TEST(LayoutCacheTest, fontFeatureSettingsTest) {
+    auto text = utf8ToUtf16("1234");
+    Range range(0, text.size());
+    auto collection = buildFontCollection("Ascii.ttf");
+
+    TestableLayoutCache layoutCache(kTestCacheSize);
+
+    // Paints with font feature settings are cached as well.
+    MinikinPaint paint1(collection);
+    paint1.fontFeatureSettings = "'tnum' on";
+    LayoutCapture layout1;
+    layoutCache.getOrCreate(text, range, paint1, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                            EndHyphenEdit::NO_EDIT, layout1);
+    MinikinPaint paint2(collection);
+    paint2.fontFeatureSettings = "'tnum' on";
+    LayoutCapture layout2;
+    layoutCache.getOrCreate(text, range, paint2, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                            EndHyphenEdit::NO_EDIT, layout2);
+    EXPECT_EQ(layout1.get(), layout2.get());
+    EXPECT_EQ(1u, layoutCache.getCacheSize());
+}
+
+TEST(LayoutCacheTest, longPieceTest) {
+    auto word = utf8ToUtf16("android");
+    auto longText = utf8ToUtf16(std::string(LENGTH_LIMIT_CACHE + 2, 'a'));
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+
+    TestableLayoutCache layoutCache(kTestCacheSize);
+
+    LayoutCapture layout1;
+    layoutCache.getOrCreate(word, Range(0, word.size()), paint, false /* LTR */,
+                            StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout1);
+    LayoutCapture layout2;
+    layoutCache.getOrCreate(longText, Range(0, longText.size()), paint, false /* LTR */,
+                            StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout2);
+    EXPECT_EQ(2u, layoutCache.getCacheSize());
+
+    // A long piece is a cache hit when it is rendered again.
+    LayoutCapture layout3;
+    layoutCache.getOrCreate(longText, Range(0, longText.size()), paint, false /* LTR */,
+                            StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout3);
+    EXPECT_EQ(layout2.get(), layout3.get());
+
+    // Long pieces only evict each other, never the words.
+    for (char c = 'a'; c <= 'z'; c++) {
+        auto text = utf8ToUtf16(std::string(LENGTH_LIMIT_CACHE * 4, c));
+        for (int i = 0; i < 2; ++i) {
+            LayoutCapture layout;
+            layoutCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                                    StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout);
+        }
     }
+    LayoutCapture layout4;
+    layoutCache.getOrCreate(word, Range(0, word.size()), paint, false /* LTR */,
+                            StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout4);
+    EXPECT_EQ(layout1.get(), layout4.get());
+}
+
+TEST(LayoutCacheTest, threadCacheTest) {
+    auto text = utf8ToUtf16("android");
+    Range range(0, text.size());
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+
+    TestableLayoutCache layoutCache(kTestCacheSize, 1, true /* useAdmissionFilter */,
+                                    true /* useThreadCache */);
+    LayoutCapture layout1;
+    layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                            EndHyphenEdit::NO_EDIT, layout1);
+    EXPECT_EQ(1u, layoutCache.getMissCount());
+
+    // The thread cache keeps the layout after it is evicted from the shared cache.
+    layoutCache.setMaxSizeInBytes(0);
+    EXPECT_EQ(0u, layoutCache.getCacheSize());
+    LayoutCapture layout2;
+    layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                            EndHyphenEdit::NO_EDIT, layout2);
+    EXPECT_EQ(layout1.get(), layout2.get());
+    EXPECT_EQ(1u, layoutCache.getMissCount());
+
+    // Other threads don't see it.
+    std::thread([&] {
+        LayoutCapture layout;
+        layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                                EndHyphenEdit::NO_EDIT, layout);
+        EXPECT_NE(layout1.get(), layout.get());
+    }).join();
+    EXPECT_EQ(2u, layoutCache.getMissCount());
 
+    // Clearing the cache invalidates the thread caches as well.
+    layoutCache.setMaxSizeInBytes(kTestCacheSize);
+    layoutCache.clear();
     LayoutCapture layout3;
     layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
                             EndHyphenEdit::NO_EDIT, layout3);
-    EXPECT_NE(layout1.get(), layout3.get());
+    EXPECT_EQ(1u, layoutCache.getCacheSize());
+
+    // The layout just done is in the thread cache again.
+    std::shared_ptr<const LayoutPiece> layout4 = layoutCache.getOrCreate(
+            text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+    EXPECT_EQ(layout3.get(), layout4.get());
+}
+
+TEST(LayoutCacheTest, sizeIndependentLayoutTest) {
+    auto text = utf8ToUtf16("android");
+    Range range(0, text.size());
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+    paint.fontFlags = LinearMetrics_Flag;
+
+    TestableLayoutCache layoutCache(kTestCacheSize);
+    layoutCache.setSizeIndependentLayoutEnabled(true);
+
+    paint.size = 10.0f;
+    std::shared_ptr<const LayoutPiece> layout1 = layoutCache.getOrCreate(
+            text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+    paint.size = 20.0f;
+    std::shared_ptr<const LayoutPiece> layout2 = layoutCache.getOrCreate(
+            text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+    LayoutCapture layout3;
+    layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                            EndHyphenEdit::NO_EDIT, layout3);
+
+    // Both sizes are derived from the same cached layout.
+    EXPECT_EQ(1u, layoutCache.getCacheSize());
+    EXPECT_EQ(1u, layoutCache.getMissCount());
+    EXPECT_FLOAT_EQ(layout1->advance() * 2, layout2->advance());
+    EXPECT_FLOAT_EQ(layout1->advances()[0] * 2, layout2->advances()[0]);
+    EXPECT_EQ(layout1->glyphIds(), layout2->glyphIds());
+
+    // Layouts without linear metrics are cached for each size.
+    paint.fontFlags = 0;
+    layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                            EndHyphenEdit::NO_EDIT);
+    paint.size = 10.0f;
+    layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                            EndHyphenEdit::NO_EDIT);
+    EXPECT_EQ(3u, layoutCache.getCacheSize());
+}
+
+TEST(LayoutCacheTest, letterSpacingDerivationTest) {
+    auto text = utf8ToUtf16("android");
+    Range range(0, text.size());
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+    paint.size = 10.0f;
+    paint.scaleX = 1.0f;
+
+    TestableLayoutCache layoutCache(kTestCacheSize);
+    layoutCache.setLetterSpacingDerivationEnabled(true);
+
+    std::vector<float> advances;
+    for (float letterSpacing : {0.1f, 0.2f, -0.5f}) {
+        paint.letterSpacing = letterSpacing;
+        std::shared_ptr<const LayoutPiece> layout =
+                layoutCache.getOrCreate(text, range, paint, false /* LTR */,
+                                        StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+        advances.push_back(layout->advance());
+    }
+    // All of them are derived from the same base layout.
+    EXPECT_EQ(1u, layoutCache.getCacheSize());
+    EXPECT_EQ(1u, layoutCache.getMissCount());
+    EXPECT_LT(advances[0], advances[1]);
+    EXPECT_GT(advances[0], advances[2]);
+
+    // The derived layout is the same as the one done with the letter spacing.
+    std::shared_ptr<const LayoutPiece> derived = layoutCache.getOrCreate(
+            text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+    LayoutPiece expected(text, range, false /* LTR */, paint, StartHyphenEdit::NO_EDIT,
+                         EndHyphenEdit::NO_EDIT);
+    EXPECT_EQ(expected.advance(), derived->advance());
+    EXPECT_EQ(expected.advances(), derived->advances());
+    EXPECT_EQ(expected.points(), derived->points());
+
+    // Small letter spacings keep the ligatures, so they have another base layout.
+    paint.letterSpacing = 0.01f;
+    layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                            EndHyphenEdit::NO_EDIT);
+    EXPECT_EQ(2u, layoutCache.getCacheSize());
+
+    // Layouts without letter spacing are cached as is.
+    paint.letterSpacing = 0;
+    layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                            EndHyphenEdit::NO_EDIT);
+    EXPECT_EQ(3u, layoutCache.getCacheSize());
+}
+
+TEST(LayoutCacheTest, advancesOnlyTest) {
+    auto text = utf8ToUtf16("android");
+    Range range(0, text.size());
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+
+    TestableLayoutCache layoutCache(kTestCacheSize);
+    LayoutCapture measured;
+    layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                            EndHyphenEdit::NO_EDIT, true /* advancesOnly */, measured);
+    EXPECT_TRUE(measured.get()->isAdvancesOnly());
+    EXPECT_EQ(0u, measured.get()->glyphCount());
+    EXPECT_EQ(text.size(), measured.get()->advances().size());
+    EXPECT_EQ(1u, layoutCache.getMissCount());
+    const size_t measuredSizeInBytes = layoutCache.getEntrySizeInBytes();
+
+    LayoutCapture measuredAgain;
+    layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                            EndHyphenEdit::NO_EDIT, true /* advancesOnly */, measuredAgain);
+    EXPECT_EQ(measured.get(), measuredAgain.get());
+    EXPECT_EQ(1u, layoutCache.getMissCount());
+
+    // Requesting the full layout replaces the cached advances.
+    std::shared_ptr<const LayoutPiece> full =
+            layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                                    EndHyphenEdit::NO_EDIT);
+    EXPECT_FALSE(full->isAdvancesOnly());
+    EXPECT_EQ(text.size(), full->glyphCount());
+    EXPECT_EQ(2u, layoutCache.getMissCount());
+    EXPECT_EQ(1u, layoutCache.getCacheSize());
+    EXPECT_LT(measuredSizeInBytes, layoutCache.getEntrySizeInBytes());
+
+    // The full layout also serves the measurements.
+    LayoutCapture measuredFull;
+    layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                            EndHyphenEdit::NO_EDIT, true /* advancesOnly */, measuredFull);
+    EXPECT_EQ(full.get(), measuredFull.get());
+    EXPECT_EQ(2u, layoutCache.getMissCount());
+}
+
+TEST(LayoutCacheTest, concurrentAdvancesOnlyTest) {
+    constexpr int kThreadCount = 8;
+    constexpr int kIterations = 200;
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+
+    struct GlyphCountCapture {
+        void operator()(const LayoutPiece& layout, const MinikinPaint& /* paint */) {
+            glyphCount = layout.glyphCount();
+        }
+
+        uint32_t glyphCount = 0;
+    };
+
+    TestableLayoutCache layoutCache(kTestCacheSize);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreadCount; ++i) {
+        threads.emplace_back([&, i] {
+            for (int j = 0; j < kIterations; ++j) {
+                auto text = utf8ToUtf16(std::to_string(j % 16));
+                const bool advancesOnly = (i + j) % 2 == 0;
+                GlyphCountCapture capture;
+                layoutCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                                        StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT,
+                                        advancesOnly, capture);
+                // The full layouts are never served by the layouts done with advancesOnly.
+                if (!advancesOnly) {
+                    EXPECT_EQ(text.size(), capture.glyphCount);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(16u, layoutCache.getCacheSize());
+}
+
+TEST(LayoutCacheTest, removeFontCollectionTest) {
+    MinikinPaint paint1(buildFontCollection("Ascii.ttf"));
+    MinikinPaint paint2(buildFontCollection("Ascii.ttf"));
+
+    TestableLayoutCache layoutCache(kTestCacheSize, 4);
+
+    std::vector<std::vector<uint16_t>> texts;
+    for (char c = 'a'; c <= 'z'; c++) {
+        texts.push_back(utf8ToUtf16(std::string(3, c)));
+    }
+    for (const auto& text : texts) {
+        for (const MinikinPaint* paint : {&paint1, &paint2}) {
+            layoutCache.getOrCreate(text, Range(0, text.size()), *paint, false /* LTR */,
+                                    StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+        }
+    }
+    EXPECT_EQ(texts.size() * 2, layoutCache.getCacheSize());
+    const uint64_t missCount = layoutCache.getMissCount();
+
+    layoutCache.removeFontCollection(paint1.font->getId());
+    EXPECT_EQ(texts.size(), layoutCache.getCacheSize());
+
+    // The layouts of the other font collection are still in the cache.
+    for (const auto& text : texts) {
+        layoutCache.getOrCreate(text, Range(0, text.size()), paint2, false /* LTR */,
+                                StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+    }
+    EXPECT_EQ(missCount, layoutCache.getMissCount());
+
+    // The removed ones are done again.
+    layoutCache.getOrCreate(texts[0], Range(0, texts[0].size()), paint1, false /* LTR */,
+                            StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+    EXPECT_EQ(missCount + 1, layoutCache.getMissCount());
+    EXPECT_EQ(texts.size() + 1, layoutCache.getCacheSize());
+}
+
+TEST(LayoutCacheTest, destroyFontCollectionTest) {
+    auto text = utf8ToUtf16("android");
+    Range range(0, text.size());
+    LayoutCache& layoutCache = LayoutCache::getInstance();
+    EXPECT_EQ(&layoutCache, LayoutCache::getInstanceIfCreated());
+    const size_t sizeInBytes = layoutCache.getSizeInBytes();
+    {
+        MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+        layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
+                                EndHyphenEdit::NO_EDIT);
+        EXPECT_LT(sizeInBytes, layoutCache.getSizeInBytes());
+    }
+    // The layout is removed when the last reference to the font collection is released.
+    EXPECT_EQ(sizeInBytes, layoutCache.getSizeInBytes());
 }
 
 TEST(LayoutCacheTest, cacheLengthLimitTest) {
-    auto text = utf8ToUtf16(std::string(130, 'a'));
+    auto text = utf8ToUtf16(std::string(LENGTH_LIMIT_LONG_PIECE_CACHE, 'a'));
     Range range(0, text.size());
     MinikinPaint paint(buildFontCollection("Ascii.ttf"));
 
-    TestableLayoutCache layoutCache(140);
+    TestableLayoutCache layoutCache(kTestCacheSize);
 
     LayoutCapture layout;
     layoutCache.getOrCreate(text, range, paint, false /* LTR */, StartHyphenEdit::NO_EDIT,
@@ -287,4 +929,196 @@ TEST(LayoutCacheTest, cacheLengthLimitTest) {
     EXPECT_EQ(layoutCache.getCacheSize(), 0u);
 }
 
+TEST(LayoutCacheTest, shardedCacheTest) {
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+
+    TestableLayoutCache layoutCache(kTestCacheSize, 4);
+    EXPECT_EQ(4u, layoutCache.getShardCount());
+
+    std::vector<std::vector<uint16_t>> texts;
+    for (char c = 'a'; c <= 'z'; c++) {
+        texts.push_back(utf8ToUtf16(std::string(3, c)));
+    }
+
+    std::vector<const LayoutPiece*> pieces;
+    for (const auto& text : texts) {
+        LayoutCapture layout;
+        layoutCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                                StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout);
+        pieces.push_back(layout.get());
+    }
+    EXPECT_EQ(texts.size(), layoutCache.getCacheSize());
+
+    // Every entry must be found again regardless of which shard it was put into.
+    for (size_t i = 0; i < texts.size(); ++i) {
+        LayoutCapture layout;
+        layoutCache.getOrCreate(texts[i], Range(0, texts[i].size()), paint, false /* LTR */,
+                                StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout);
+        EXPECT_EQ(pieces[i], layout.get());
+    }
+
+    layoutCache.clear();
+    EXPECT_EQ(0u, layoutCache.getCacheSize());
+}
+
+TEST(LayoutCacheTest, animatedSizeTest) {
+    auto text = utf8ToUtf16("android");
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+    const uint32_t paintCount = LayoutPaintCache::getSize();
+    {
+        // Small enough that most of the sizes are evicted.
+        TestableLayoutCache layoutCache(64 * 1024, 1, false /* useAdmissionFilter */);
+        int64_t maxExtraPaintCount = 0;
+        for (int i = 0; i < 10000; ++i) {
+            paint.size = 10.0f + i * 0.01f;
+            LayoutCapture layout;
+            layoutCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                                    StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT, layout);
+            const int64_t extraPaintCount = static_cast<int64_t>(LayoutPaintCache::getSize()) -
+                                            paintCount - layoutCache.getCacheSize();
+            maxExtraPaintCount = std::max(maxExtraPaintCount, extraPaintCount);
+        }
+        // Only the paints of the cached layouts, of the evicted layouts not freed yet and of the
+        // last layout of this thread are kept.
+        EXPECT_GE(2, maxExtraPaintCount);
+    }
+    // The paints of a destructed cache are all released.
+    EXPECT_GE(paintCount + 1, LayoutPaintCache::getSize());
+}
+
+static std::vector<std::vector<uint16_t>> writeTestSnapshot(
+        const std::string& path, const std::shared_ptr<FontCollection>& collection,
+        std::vector<std::shared_ptr<const LayoutPiece>>* layouts) {
+    MinikinPaint paint(collection);
+    paint.size = 10.0f;
+    paint.localeListId = registerLocaleList("en-US");
+
+    std::vector<std::vector<uint16_t>> texts = {utf8ToUtf16("android"), utf8ToUtf16("minikin")};
+    TestableLayoutCache layoutCache(kTestCacheSize);
+    for (const auto& text : texts) {
+        layouts->push_back(layoutCache.getOrCreate(text, Range(0, text.size()), paint,
+                                                   false /* LTR */, StartHyphenEdit::NO_EDIT,
+                                                   EndHyphenEdit::NO_EDIT));
+    }
+    EXPECT_TRUE(layoutCache.writeSnapshot(path, {collection}));
+    return texts;
+}
+
+TEST(LayoutCacheTest, snapshotTest) {
+    const std::string path = testing::TempDir() + "LayoutCacheTest_snapshotTest";
+    auto collection = buildFontCollection("Ascii.ttf");
+    std::vector<std::shared_ptr<const LayoutPiece>> expected;
+    auto texts = writeTestSnapshot(path, collection, &expected);
+
+    MinikinPaint paint(collection);
+    paint.size = 10.0f;
+    paint.localeListId = registerLocaleList("en-US");
+
+    TestableLayoutCache layoutCache(kTestCacheSize);
+    EXPECT_EQ(2u, layoutCache.readSnapshot(path, {collection}));
+    EXPECT_EQ(2u, layoutCache.getCacheSize());
+    for (size_t i = 0; i < texts.size(); ++i) {
+        std::shared_ptr<const LayoutPiece> layout = layoutCache.getOrCreate(
+                texts[i], Range(0, texts[i].size()), paint, false /* LTR */,
+                StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+        EXPECT_EQ(expected[i]->fontIndices(), layout->fontIndices());
+        EXPECT_EQ(expected[i]->glyphIds(), layout->glyphIds());
+        EXPECT_EQ(expected[i]->points(), layout->points());
+        EXPECT_EQ(expected[i]->advances(), layout->advances());
+        EXPECT_EQ(expected[i]->advance(), layout->advance());
+        EXPECT_EQ(expected[i]->bounds(), layout->bounds());
+        EXPECT_EQ(expected[i]->extent(), layout->extent());
+        EXPECT_EQ(expected[i]->fonts(), layout->fonts());
+    }
+    // All the layouts came from the snapshot.
+    EXPECT_EQ(0u, layoutCache.getMissCount());
+    remove(path.c_str());
+}
+
+TEST(LayoutCacheTest, snapshotStaleFontTest) {
+    const std::string path = testing::TempDir() + "LayoutCacheTest_snapshotStaleFontTest";
+    std::vector<std::shared_ptr<const LayoutPiece>> layouts;
+    writeTestSnapshot(path, buildFontCollection("Ascii.ttf"), &layouts);
+
+    TestableLayoutCache layoutCache(kTestCacheSize);
+    EXPECT_EQ(0u, layoutCache.readSnapshot(path, {buildFontCollection("Emoji.ttf")}));
+    EXPECT_EQ(0u, layoutCache.readSnapshot(path, {}));
+    EXPECT_EQ(0u, layoutCache.getCacheSize());
+    remove(path.c_str());
+}
+
+TEST(LayoutCacheTest, snapshotBrokenFileTest) {
+    const std::string path = testing::TempDir() + "LayoutCacheTest_snapshotBrokenFileTest";
+    auto collection = buildFontCollection("Ascii.ttf");
+
+    TestableLayoutCache layoutCache(kTestCacheSize);
+    EXPECT_EQ(0u, layoutCache.readSnapshot(path, {collection}));  // No file.
+
+    std::vector<std::shared_ptr<const LayoutPiece>> layouts;
+    writeTestSnapshot(path, collection, &layouts);
+    FILE* file = fopen(path.c_str(), "rb");
+    ASSERT_NE(nullptr, file);
+    std::vector<char> data(4096);
+    data.resize(fread(data.data(), 1, data.size(), file));
+    fclose(file);
+
+    // A truncated file loads only the complete layouts.
+    file = fopen(path.c_str(), "wb");
+    fwrite(data.data(), 1, data.size() - 8, file);
+    fclose(file);
+    EXPECT_EQ(1u, layoutCache.readSnapshot(path, {collection}));
+
+    // A file of another version is ignored.
+    layoutCache.clear();
+    data[4]++;
+    file = fopen(path.c_str(), "wb");
+    fwrite(data.data(), 1, data.size(), file);
+    fclose(file);
+    EXPECT_EQ(0u, layoutCache.readSnapshot(path, {collection}));
+    remove(path.c_str());
+}
+
+// Overwrites the range of the entry of the text in the snapshot data, and its size with a value
+// which no paint has.
+static void corruptSnapshotEntry(std::vector<char>* data, const std::vector<uint16_t>& text,
+                                 uint32_t start, uint32_t count) {
+    const char* chars = reinterpret_cast<const char*>(text.data());
+    auto it = std::search(data->begin(), data->end(), chars, chars + text.size() * 2);
+    ASSERT_NE(data->end(), it);
+    // The start, the count, the weight, the slant and the size follow the 4-byte aligned text.
+    size_t pos = ((it - data->begin()) + text.size() * 2 + 3) & ~3;
+    const float size = 12345.0f;
+    memcpy(data->data() + pos, &start, sizeof(start));
+    memcpy(data->data() + pos + 4, &count, sizeof(count));
+    memcpy(data->data() + pos + 12, &size, sizeof(size));
+}
+
+TEST(LayoutCacheTest, snapshotCorruptedEntryTest) {
+    const std::string path = testing::TempDir() + "LayoutCacheTest_snapshotCorruptedEntryTest";
+    auto collection = buildFontCollection("Ascii.ttf");
+    std::vector<std::shared_ptr<const LayoutPiece>> layouts;
+    auto texts = writeTestSnapshot(path, collection, &layouts);
+    FILE* file = fopen(path.c_str(), "rb");
+    ASSERT_NE(nullptr, file);
+    std::vector<char> data(4096);
+    data.resize(fread(data.data(), 1, data.size(), file));
+    fclose(file);
+
+    // The range of the first entry exceeds its text, and the second one has more advances than
+    // the characters of its range.
+    corruptSnapshotEntry(&data, texts[0], 1, texts[0].size());
+    corruptSnapshotEntry(&data, texts[1], 1, texts[1].size() - 2);
+    file = fopen(path.c_str(), "wb");
+    fwrite(data.data(), 1, data.size(), file);
+    fclose(file);
+
+    const uint32_t paintCount = LayoutPaintCache::getSize();
+    TestableLayoutCache layoutCache(kTestCacheSize);
+    EXPECT_EQ(0u, layoutCache.readSnapshot(path, {collection}));
+    EXPECT_EQ(0u, layoutCache.getCacheSize());
+    // The paints of the rejected entries are not interned.
+    EXPECT_EQ(paintCount, LayoutPaintCache::getSize());
+    remove(path.c_str());
+}
+
 }  // namespace minikin
@@ -251,5 +251,102 @@ TEST(LayoutPieceTest, doLayoutTest_Ligature) {
     }
 }
 
+TEST(LayoutPieceTest, withLetterSpaceTest) {
+    auto fc = std::make_shared<FontCollection>(buildFontFamily("LayoutTestFont.ttf"));
+    auto text = utf8ToUtf16("IIV X.");
+    const Range range(0, text.size());
+
+    for (float letterSpacing : {0.02f, -0.02f, 0.2f, 1.5f, -0.1f}) {
+        SCOPED_TRACE(letterSpacing);
+        MinikinPaint paint(fc);
+        paint.size = 10.0f;
+        paint.scaleX = 1.0f;
+        paint.letterSpacing = letterSpacing;
+        LayoutPiece expected(text, range, false /* rtl */, paint, StartHyphenEdit::NO_EDIT,
+                             EndHyphenEdit::NO_EDIT);
+
+        // The base is done with a letter spacing which disables the same ligatures.
+        MinikinPaint basePaint(paint);
+        basePaint.letterSpacing = isLigatureDisabledByLetterSpacing(letterSpacing) ? 1.0f : 0.0f;
+        LayoutPiece base(text, range, false /* rtl */, basePaint, StartHyphenEdit::NO_EDIT,
+                         EndHyphenEdit::NO_EDIT, true /* keepGlyphInfo */);
+        LayoutPiece layout = base.withLetterSpace(letterSpacing * paint.size * paint.scaleX);
+
+        EXPECT_EQ(expected.glyphIds(), layout.glyphIds());
+        EXPECT_EQ(expected.points(), layout.points());
+        EXPECT_EQ(expected.advances(), layout.advances());
+        EXPECT_EQ(expected.advance(), layout.advance());
+        EXPECT_EQ(expected.bounds(), layout.bounds());
+        EXPECT_EQ(expected.extent(), layout.extent());
+    }
+}
+
+TEST(LayoutPieceTest, advancesOnlyTest) {
+    auto fc = std::make_shared<FontCollection>(buildFontFamily("LayoutTestFont.ttf"));
+    auto text = utf8ToUtf16("IIV X.");
+    const Range range(0, text.size());
+    MinikinPaint paint(fc);
+    paint.size = 10.0f;
+    paint.letterSpacing = 0.2f;
+
+    LayoutPiece full(text, range, false /* rtl */, paint, StartHyphenEdit::NO_EDIT,
+                     EndHyphenEdit::NO_EDIT);
+    LayoutPiece measured(text, range, false /* rtl */, paint, StartHyphenEdit::NO_EDIT,
+                         EndHyphenEdit::NO_EDIT, false /* keepGlyphInfo */,
+                         true /* advancesOnly */);
+    EXPECT_FALSE(full.isAdvancesOnly());
+    EXPECT_TRUE(measured.isAdvancesOnly());
+    EXPECT_EQ(full.advances(), measured.advances());
+    EXPECT_EQ(full.advance(), measured.advance());
+    EXPECT_EQ(full.extent(), measured.extent());
+    EXPECT_EQ(0u, measured.glyphCount());
+    EXPECT_TRUE(measured.fonts().empty());
+    EXPECT_TRUE(measured.bounds().isEmpty());
+    EXPECT_GT(full.getMemoryUsage(), measured.getMemoryUsage());
+}
+
+TEST(LayoutPieceTest, copyTest) {
+    LayoutPiece layout = buildLayout("I\u3042I", {"LayoutTestFont.ttf", "Hiragana.ttf"});
+    EXPECT_EQ(3u, layout.glyphCount());
+    EXPECT_EQ(2u, layout.fonts().size());
+
+    // The copy owns its own arrays.
+    LayoutPiece copy(layout);
+    EXPECT_NE(layout.advances().data(), copy.advances().data());
+    EXPECT_EQ(layout.fontIndices(), copy.fontIndices());
+    EXPECT_EQ(layout.glyphIds(), copy.glyphIds());
+    EXPECT_EQ(layout.points(), copy.points());
+    EXPECT_EQ(layout.advances(), copy.advances());
+    EXPECT_EQ(layout.fonts(), copy.fonts());
+    EXPECT_EQ(layout.getMemoryUsage(), copy.getMemoryUsage());
+
+    // Moving keeps the arrays, and leaves the moved-from layout empty.
+    const float* advances = copy.advances().data();
+    LayoutPiece moved(std::move(copy));
+    EXPECT_EQ(advances, moved.advances().data());
+    EXPECT_EQ(layout.points(), moved.points());
+    EXPECT_EQ(0u, copy.glyphCount());
+    EXPECT_TRUE(copy.advances().empty());
+    EXPECT_TRUE(copy.fonts().empty());
+
+    copy = moved;
+    EXPECT_EQ(layout.glyphIds(), copy.glyphIds());
+    EXPECT_EQ(layout.advances(), copy.advances());
+}
+
+TEST(LayoutPieceTest, scaledTest) {
+    LayoutPiece layout = buildLayout("IIV X.", {"LayoutTestFont.ttf"});
+    LayoutPiece scaled = layout.scaled(2.0f);
+    EXPECT_EQ(layout.glyphIds(), scaled.glyphIds());
+    EXPECT_EQ(layout.fonts(), scaled.fonts());
+    EXPECT_EQ(layout.advance() * 2, scaled.advance());
+    for (uint32_t i = 0; i < layout.glyphCount(); ++i) {
+        EXPECT_EQ(layout.pointAt(i).x * 2, scaled.pointAt(i).x);
+    }
+    for (uint32_t i = 0; i < layout.advances().size(); ++i) {
+        EXPECT_EQ(layout.advances()[i] * 2, scaled.advances()[i]);
+    }
+}
+
 }  // namespace
 }  // namespace minikin
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/LayoutPaint.h"
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "minikin/FontCollection.h"
+
+#include "FontTestUtils.h"
+#include "LayoutPaintCache.h"
+
+namespace minikin {
+
+TEST(LayoutPaintCacheTest, registerLayoutPaint) {
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+    paint.size = 10.0f;
+
+    // Keep the ID while registering other paints.
+    const uint32_t id = registerLayoutPaint(paint, paint.size, paint.letterSpacing, false);
+    acquireLayoutPaint(id);
+    EXPECT_EQ(id, registerLayoutPaint(paint, paint.size, paint.letterSpacing, false));
+    EXPECT_NE(id, registerLayoutPaint(paint, 20.0f, paint.letterSpacing, false));
+    EXPECT_NE(id, registerLayoutPaint(paint, paint.size, 1.0f, false));
+    EXPECT_NE(id, registerLayoutPaint(paint, paint.size, paint.letterSpacing, true));
+
+    // Copies of the paint share the ID.
+    MinikinPaint copy(paint);
+    EXPECT_EQ(id, registerLayoutPaint(copy, copy.size, copy.letterSpacing, false));
+
+    copy.fontFeatureSettings = "'tnum' on";
+    const uint32_t featureId = registerLayoutPaint(copy, copy.size, copy.letterSpacing, false);
+    acquireLayoutPaint(featureId);
+    EXPECT_NE(id, featureId);
+    copy.fontFeatureSettings = "'smcp' on";
+    EXPECT_NE(featureId, registerLayoutPaint(copy, copy.size, copy.letterSpacing, false));
+    releaseLayoutPaint(featureId);
+
+    MinikinPaint otherFont(buildFontCollection("Ascii.ttf"));
+    otherFont.size = 10.0f;
+    EXPECT_NE(id, registerLayoutPaint(otherFont, otherFont.size, otherFont.letterSpacing, false));
+    releaseLayoutPaint(id);
+}
+
+TEST(LayoutPaintCacheTest, getLayoutPaint) {
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+    paint.size = 10.0f;
+    paint.scaleX = 2.0f;
+    paint.localeListId = 3;
+
+    const LayoutPaint& layoutPaint = getLayoutPaint(registerLayoutPaint(paint, 1024.0f, 1, true));
+    EXPECT_EQ(paint.font->getId(), layoutPaint.fontCollectionId);
+    EXPECT_EQ(1024.0f, layoutPaint.size);
+    EXPECT_EQ(2.0f, layoutPaint.scaleX);
+    EXPECT_EQ(1.0f, layoutPaint.letterSpacing);
+    EXPECT_EQ(3u, layoutPaint.localeListId);
+    EXPECT_TRUE(layoutPaint.isLetterSpacingBase);
+
+    // Registering the same layout paint directly gives the same ID.
+    const uint32_t id = registerLayoutPaint(layoutPaint);
+    EXPECT_EQ(registerLayoutPaint(paint, 1024.0f, 1, true), id);
+    releaseLayoutPaint(id);
+}
+
+TEST(LayoutPaintCacheTest, releaseTest) {
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+    const uint32_t size = LayoutPaintCache::getSize();
+
+    // The thread keeps the last paint it registered.
+    const uint32_t id = registerLayoutPaint(paint, 10.0f, 0, false);
+    acquireLayoutPaint(id);
+    registerLayoutPaint(paint, 20.0f, 0, false);
+    EXPECT_EQ(10.0f, getLayoutPaint(id).size);
+
+    // The ID is released with its last reference, and reused for the next new paint.
+    releaseLayoutPaint(id);
+    EXPECT_EQ(id, registerLayoutPaint(paint, 30.0f, 0, false));
+    EXPECT_EQ(30.0f, getLayoutPaint(id).size);
+    EXPECT_GE(size + 1, LayoutPaintCache::getSize());
+}
+
+TEST(LayoutPaintCacheTest, concurrentRegistration) {
+    // Enough paints to fill several blocks.
+    constexpr int kPaintCount = 1000;
+    constexpr int kThreadCount = 4;
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+
+    std::vector<std::vector<uint32_t>> ids(kThreadCount);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreadCount; ++i) {
+        threads.emplace_back([&paint, &ids, i]() {
+            for (int j = 0; j < kPaintCount; ++j) {
+                ids[i].push_back(registerLayoutPaint(paint, j, 0, false));
+                acquireLayoutPaint(ids[i].back());
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (int i = 1; i < kThreadCount; ++i) {
+        EXPECT_EQ(ids[0], ids[i]);
+    }
+    for (int j = 0; j < kPaintCount; ++j) {
+        EXPECT_EQ(static_cast<float>(j), getLayoutPaint(ids[0][j]).size);
+    }
+    EXPECT_LE(static_cast<uint32_t>(kPaintCount), LayoutPaintCache::getSize());
+
+    // The paints are released with the references of all the threads.
+    const uint32_t size = LayoutPaintCache::getSize();
+    for (const auto& threadIds : ids) {
+        for (uint32_t id : threadIds) {
+            releaseLayoutPaint(id);
+        }
+    }
+    EXPECT_EQ(size - kPaintCount, LayoutPaintCache::getSize());
+}
+
+}  // namespace minikin
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "minikin/LayoutPrefetcher.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "FontTestUtils.h"
+#include "UnicodeUtils.h"
+
+namespace minikin {
+
+namespace {
+
+class TestableLayoutCache : public LayoutCache {
+public:
+    TestableLayoutCache() : LayoutCache(1024 * 1024) {}
+};
+
+std::vector<LayoutPrefetcher::Request> buildWords(const MinikinPaint& paint, int count) {
+    std::vector<LayoutPrefetcher::Request> requests;
+    for (int i = 0; i < count; ++i) {
+        requests.emplace_back(utf8ToUtf16(std::to_string(i)), paint, Bidi::LTR);
+    }
+    return requests;
+}
+
+}  // namespace
+
+TEST(LayoutPrefetcherTest, prefetchTest) {
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+    TestableLayoutCache layoutCache;
+    LayoutPrefetcher prefetcher(&layoutCache);
+
+    std::vector<LayoutPrefetcher::Request> requests;
+    requests.emplace_back(utf8ToUtf16("android"), paint, Bidi::LTR);
+    prefetcher.prefetch(std::move(requests));
+    prefetcher.waitUntilIdle();
+    EXPECT_EQ(1u, layoutCache.getMissCount());
+
+    // The prefetched word is found in the cache.
+    auto text = utf8ToUtf16("android");
+    layoutCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                            StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+    EXPECT_EQ(1u, layoutCache.getMissCount());
+
+    // Words which are already in the cache are not laid out again.
+    prefetcher.prefetch(buildWords(paint, 10));
+    prefetcher.prefetch(buildWords(paint, 10));
+    prefetcher.waitUntilIdle();
+    EXPECT_EQ(11u, layoutCache.getMissCount());
+}
+
+TEST(LayoutPrefetcherTest, cancelTest) {
+    constexpr int kWordCount = 10000;
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+    TestableLayoutCache layoutCache;
+    LayoutPrefetcher prefetcher(&layoutCache);
+
+    const uint64_t id = prefetcher.prefetch(buildWords(paint, kWordCount));
+    prefetcher.cancel(id);
+    prefetcher.waitUntilIdle();
+    EXPECT_GT(static_cast<uint64_t>(kWordCount), layoutCache.getMissCount());
+
+    prefetcher.prefetch(buildWords(paint, kWordCount));
+    prefetcher.prefetch(buildWords(paint, kWordCount));
+    prefetcher.cancelAll();
+    prefetcher.waitUntilIdle();
+    EXPECT_GT(static_cast<uint64_t>(kWordCount) * 2, layoutCache.getMissCount());
+
+    // Cancelling doesn't affect the batches queued later.
+    std::vector<LayoutPrefetcher::Request> requests;
+    requests.emplace_back(utf8ToUtf16("android"), paint, Bidi::LTR);
+    prefetcher.prefetch(std::move(requests));
+    prefetcher.waitUntilIdle();
+    const uint64_t missCount = layoutCache.getMissCount();
+    auto text = utf8ToUtf16("android");
+    layoutCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                            StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+    EXPECT_EQ(missCount, layoutCache.getMissCount());
+}
+
+TEST(LayoutPrefetcherTest, busyForegroundTest) {
+    constexpr int kWordCount = 100;
+    constexpr int kForegroundThreadCount = 2;
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+    TestableLayoutCache layoutCache;
+    LayoutPrefetcher prefetcher(&layoutCache);
+
+    // Other threads keep laying out long words which are never in the cache, so that a layout is
+    // almost always in progress.
+    std::atomic<bool> stopped(false);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kForegroundThreadCount; ++i) {
+        threads.emplace_back([&layoutCache, &paint, &stopped, i] {
+            for (int j = 0; !stopped; ++j) {
+                const std::string word = std::string(1000, 'a' + i) + std::to_string(j);
+                auto text = utf8ToUtf16(word);
+                layoutCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                                        StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+            }
+        });
+    }
+
+    // The prefetching still completes.
+    prefetcher.prefetch(buildWords(paint, kWordCount));
+    prefetcher.waitUntilIdle();
+    stopped = true;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (int i = 0; i < kWordCount; ++i) {
+        const uint64_t missCount = layoutCache.getMissCount();
+        auto text = utf8ToUtf16(std::to_string(i));
+        layoutCache.getOrCreate(text, Range(0, text.size()), paint, false /* LTR */,
+                                StartHyphenEdit::NO_EDIT, EndHyphenEdit::NO_EDIT);
+        EXPECT_EQ(missCount, layoutCache.getMissCount()) << i;
+    }
+}
+
+TEST(LayoutPrefetcherTest, destructWhilePrefetchingTest) {
+    MinikinPaint paint(buildFontCollection("Ascii.ttf"));
+    TestableLayoutCache layoutCache;
+    {
+        LayoutPrefetcher prefetcher(&layoutCache);
+        prefetcher.prefetch(buildWords(paint, 10000));
+        prefetcher.prefetch(buildWords(paint, 10000));
+    }
+    EXPECT_GT(20000u, layoutCache.getMissCount());
+}
+
+}  // namespace minikin
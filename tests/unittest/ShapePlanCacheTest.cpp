@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ShapePlanCache.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "minikin/FontCollection.h"
+
+#include "FontFeatureCache.h"
+#include "FontTestUtils.h"
+#include "UnicodeUtils.h"
+
+namespace minikin {
+
+namespace {
+
+class TestableShapePlanCache : public ShapePlanCache {
+public:
+    explicit TestableShapePlanCache(uint32_t maxSize) : ShapePlanCache(maxSize) {}
+};
+
+hb_segment_properties_t buildProps(hb_script_t script, hb_direction_t direction,
+                                   const char* language) {
+    hb_segment_properties_t props = {};
+    props.script = script;
+    props.direction = direction;
+    props.language = hb_language_from_string(language, -1);
+    return props;
+}
+
+// Expects the text to be shaped into the same glyphs, clusters and positions with the plan of the
+// cache as with hb_shape().
+void expectSameShaping(ShapePlanCache* cache, const std::string& fontFile, const std::string& text,
+                       uint32_t featureSettingsId, bool disableLigatures) {
+    SCOPED_TRACE(fontFile + ": " + text);
+    auto collection = buildFontCollection(fontFile);
+    hb_font_t* font = collection->baseFontFaked(FontStyle()).font->baseFont().get();
+    const std::vector<hb_feature_t>& features =
+            FontFeatureCache::getById(featureSettingsId, disableLigatures);
+    const std::vector<uint16_t> utf16 = utf8ToUtf16(text);
+
+    HbBufferUniquePtr expected(hb_buffer_create());
+    hb_buffer_add_utf16(expected.get(), utf16.data(), utf16.size(), 0, utf16.size());
+    hb_buffer_guess_segment_properties(expected.get());
+    hb_shape(font, expected.get(), features.data(), features.size());
+
+    HbBufferUniquePtr buffer(hb_buffer_create());
+    hb_buffer_add_utf16(buffer.get(), utf16.data(), utf16.size(), 0, utf16.size());
+    hb_buffer_guess_segment_properties(buffer.get());
+    hb_segment_properties_t props;
+    hb_buffer_get_segment_properties(buffer.get(), &props);
+    HbShapePlanUniquePtr plan = cache->get(font, props, featureSettingsId, disableLigatures);
+    ASSERT_TRUE(hb_shape_plan_execute(plan.get(), font, buffer.get(), features.data(),
+                                      features.size()));
+
+    unsigned int expectedCount;
+    hb_glyph_info_t* expectedInfo = hb_buffer_get_glyph_infos(expected.get(), &expectedCount);
+    hb_glyph_position_t* expectedPositions =
+            hb_buffer_get_glyph_positions(expected.get(), nullptr);
+    unsigned int count;
+    hb_glyph_info_t* info = hb_buffer_get_glyph_infos(buffer.get(), &count);
+    hb_glyph_position_t* positions = hb_buffer_get_glyph_positions(buffer.get(), nullptr);
+    ASSERT_EQ(expectedCount, count);
+    for (unsigned int i = 0; i < count; ++i) {
+        EXPECT_EQ(expectedInfo[i].codepoint, info[i].codepoint) << i;
+        EXPECT_EQ(expectedInfo[i].cluster, info[i].cluster) << i;
+        EXPECT_EQ(expectedPositions[i].x_advance, positions[i].x_advance) << i;
+        EXPECT_EQ(expectedPositions[i].y_advance, positions[i].y_advance) << i;
+        EXPECT_EQ(expectedPositions[i].x_offset, positions[i].x_offset) << i;
+        EXPECT_EQ(expectedPositions[i].y_offset, positions[i].y_offset) << i;
+    }
+}
+
+}  // namespace
+
+TEST(ShapePlanCacheTest, cacheTest) {
+    TestableShapePlanCache cache(16);
+    auto collection = buildFontCollection("Ascii.ttf");
+    hb_font_t* font = collection->baseFontFaked(FontStyle()).font->baseFont().get();
+    const hb_segment_properties_t props = buildProps(HB_SCRIPT_LATIN, HB_DIRECTION_LTR, "en");
+
+    HbShapePlanUniquePtr plan = cache.get(font, props, FontFeatureCache::kEmptyId, false);
+    EXPECT_NE(nullptr, plan.get());
+    EXPECT_EQ(plan.get(), cache.get(font, props, FontFeatureCache::kEmptyId, false).get());
+    EXPECT_EQ(1u, cache.getSize());
+
+    // Each script, direction, language and feature set has its own plan.
+    const uint32_t featuresId = FontFeatureCache::getId("'smcp'");
+    EXPECT_NE(plan.get(),
+              cache.get(font, buildProps(HB_SCRIPT_GREEK, HB_DIRECTION_LTR, "en"),
+                        FontFeatureCache::kEmptyId, false)
+                      .get());
+    EXPECT_NE(plan.get(),
+              cache.get(font, buildProps(HB_SCRIPT_LATIN, HB_DIRECTION_RTL, "en"),
+                        FontFeatureCache::kEmptyId, false)
+                      .get());
+    EXPECT_NE(plan.get(),
+              cache.get(font, buildProps(HB_SCRIPT_LATIN, HB_DIRECTION_LTR, "fr"),
+                        FontFeatureCache::kEmptyId, false)
+                      .get());
+    EXPECT_NE(plan.get(), cache.get(font, props, featuresId, false).get());
+    EXPECT_NE(plan.get(), cache.get(font, props, FontFeatureCache::kEmptyId, true).get());
+    EXPECT_EQ(6u, cache.getSize());
+
+    // The plan is still found after the thread used other ones.
+    EXPECT_EQ(plan.get(), cache.get(font, props, FontFeatureCache::kEmptyId, false).get());
+    EXPECT_EQ(6u, cache.getSize());
+}
+
+TEST(ShapePlanCacheTest, clearTest) {
+    TestableShapePlanCache cache(16);
+    auto collection = buildFontCollection("Ascii.ttf");
+    hb_font_t* font = collection->baseFontFaked(FontStyle()).font->baseFont().get();
+    const hb_segment_properties_t props = buildProps(HB_SCRIPT_LATIN, HB_DIRECTION_LTR, "en");
+    HbShapePlanUniquePtr plan = cache.get(font, props, FontFeatureCache::kEmptyId, false);
+
+    // The recent plan of the thread is not reused after clear().
+    cache.clear();
+    EXPECT_EQ(0u, cache.getSize());
+    HbShapePlanUniquePtr newPlan = cache.get(font, props, FontFeatureCache::kEmptyId, false);
+    EXPECT_NE(plan.get(), newPlan.get());
+    EXPECT_EQ(1u, cache.getSize());
+    EXPECT_EQ(newPlan.get(), cache.get(font, props, FontFeatureCache::kEmptyId, false).get());
+
+    // Nor by another instance.
+    TestableShapePlanCache otherCache(16);
+    EXPECT_NE(newPlan.get(),
+              otherCache.get(font, props, FontFeatureCache::kEmptyId, false).get());
+    EXPECT_EQ(1u, otherCache.getSize());
+}
+
+TEST(ShapePlanCacheTest, shapeTest) {
+    TestableShapePlanCache cache(16);
+    expectSameShaping(&cache, "Ascii.ttf", "minikin", FontFeatureCache::kEmptyId, true);
+}
+
+TEST(ShapePlanCacheTest, complexShapeTest) {
+    TestableShapePlanCache cache(16);
+    // Shaped by the Arabic and Hebrew shapers of HarfBuzz, right to left.
+    expectSameShaping(&cache, "Arabic.ttf", "\u0627\u0644\u200D\u0639\u0631\u0628\u064A\u0629",
+                      FontFeatureCache::kEmptyId, false);
+    expectSameShaping(&cache, "Arabic.ttf", "\u061C\u0633\u0644\u0627\u0645\u064B",
+                      FontFeatureCache::kEmptyId, true);
+    expectSameShaping(&cache, "Regular.ttf", "\u05E9\u05C1\u05B8\u05DC\u05D5\u05B9\u05DD",
+                      FontFeatureCache::kEmptyId, false);
+
+    // The ligatures are formed unless disabled by the features or for letter spacing.
+    expectSameShaping(&cache, "Ligature.ttf", "fi ff office", FontFeatureCache::kEmptyId, false);
+    expectSameShaping(&cache, "Ligature.ttf", "fi ff office", FontFeatureCache::kEmptyId, true);
+    expectSameShaping(&cache, "Ligature.ttf", "fi ff office", FontFeatureCache::getId("'liga' off"),
+                      false);
+    expectSameShaping(&cache, "Ligature.ttf", "fi ff office", FontFeatureCache::getId("'liga' on"),
+                      true);
+}
+
+TEST(ShapePlanCacheTest, lruTest) {
+    TestableShapePlanCache cache(2);
+    auto collection = buildFontCollection("Ascii.ttf");
+    hb_font_t* font = collection->baseFontFaked(FontStyle()).font->baseFont().get();
+    const hb_segment_properties_t latin = buildProps(HB_SCRIPT_LATIN, HB_DIRECTION_LTR, "en");
+    const hb_segment_properties_t greek = buildProps(HB_SCRIPT_GREEK, HB_DIRECTION_LTR, "en");
+    HbShapePlanUniquePtr latinPlan = cache.get(font, latin, FontFeatureCache::kEmptyId, false);
+    HbShapePlanUniquePtr greekPlan = cache.get(font, greek, FontFeatureCache::kEmptyId, false);
+
+    // The recently used plan stays in the cache when another one is added.
+    EXPECT_EQ(latinPlan.get(), cache.get(font, latin, FontFeatureCache::kEmptyId, false).get());
+    cache.get(font, buildProps(HB_SCRIPT_CYRILLIC, HB_DIRECTION_LTR, "en"),
+              FontFeatureCache::kEmptyId, false);
+    EXPECT_EQ(2u, cache.getSize());
+    EXPECT_EQ(latinPlan.get(), cache.get(font, latin, FontFeatureCache::kEmptyId, false).get());
+    EXPECT_NE(greekPlan.get(), cache.get(font, greek, FontFeatureCache::kEmptyId, false).get());
+}
+
+TEST(ShapePlanCacheTest, limitTest) {
+    TestableShapePlanCache cache(2);
+    auto collection = buildFontCollection("Ascii.ttf");
+    hb_font_t* font = collection->baseFontFaked(FontStyle()).font->baseFont().get();
+    const hb_script_t scripts[] = {HB_SCRIPT_LATIN, HB_SCRIPT_GREEK, HB_SCRIPT_CYRILLIC,
+                                   HB_SCRIPT_ARMENIAN};
+    for (hb_script_t script : scripts) {
+        cache.get(font, buildProps(script, HB_DIRECTION_LTR, "en"), FontFeatureCache::kEmptyId,
+                  false);
+        EXPECT_GE(2u, cache.getSize());
+    }
+}
+
+}  // namespace minikin
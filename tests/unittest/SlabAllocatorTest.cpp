@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SlabAllocator.h"
+
+#include <cstring>
+#include <set>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace minikin {
+
+TEST(SlabAllocatorTest, allocateTest) {
+    SlabAllocator allocator(24);
+    EXPECT_LE(24u, allocator.getBlockSize());
+    EXPECT_EQ(0u, allocator.getReservedSizeInBytes());
+
+    std::set<void*> blocks;
+    for (int i = 0; i < 100; ++i) {
+        void* block = allocator.allocate();
+        EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(block) % alignof(std::max_align_t));
+        memset(block, i, 24);
+        EXPECT_TRUE(blocks.insert(block).second);
+    }
+    EXPECT_LE(100 * allocator.getBlockSize(), allocator.getReservedSizeInBytes());
+
+    for (void* block : blocks) {
+        allocator.free(block);
+    }
+}
+
+TEST(SlabAllocatorTest, reuseTest) {
+    SlabAllocator allocator(1);
+    EXPECT_LE(sizeof(void*), allocator.getBlockSize());
+
+    void* block = allocator.allocate();
+    void* otherBlock = allocator.allocate();
+    const size_t reservedSize = allocator.getReservedSizeInBytes();
+    allocator.free(block);
+    EXPECT_EQ(block, allocator.allocate());
+    EXPECT_EQ(reservedSize, allocator.getReservedSizeInBytes());
+    allocator.free(block);
+    allocator.free(otherBlock);
+}
+
+TEST(SlabAllocatorTest, releaseTest) {
+    SlabAllocator allocator(100);
+    std::vector<void*> blocks;
+    for (int i = 0; i < 1000; ++i) {
+        blocks.push_back(allocator.allocate());
+    }
+    const size_t reservedSize = allocator.getReservedSizeInBytes();
+
+    // A chunk is released once all its blocks are freed.
+    for (size_t i = 0; i < blocks.size(); i += 2) {
+        allocator.free(blocks[i]);
+    }
+    EXPECT_EQ(reservedSize, allocator.getReservedSizeInBytes());
+    for (size_t i = 1; i < blocks.size(); i += 2) {
+        allocator.free(blocks[i]);
+    }
+    EXPECT_EQ(0u, allocator.getReservedSizeInBytes());
+
+    // The allocator is still usable.
+    void* block = allocator.allocate();
+    EXPECT_LT(0u, allocator.getReservedSizeInBytes());
+    allocator.free(block);
+    EXPECT_EQ(0u, allocator.getReservedSizeInBytes());
+}
+
+}  // namespace minikin
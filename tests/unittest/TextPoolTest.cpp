@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TextPool.h"
+
+#include <gtest/gtest.h>
+
+#include "minikin/Hasher.h"
+
+#include "UnicodeUtils.h"
+
+namespace minikin {
+
+static const uint16_t* intern(TextPool* pool, const std::vector<uint16_t>& text) {
+    return pool->intern(text, Hasher().updateShorts(text.data(), text.size()).hash());
+}
+
+TEST(TextPoolTest, internTest) {
+    TextPool pool;
+    std::vector<uint16_t> hello = utf8ToUtf16("hello");
+    std::vector<uint16_t> world = utf8ToUtf16("world");
+
+    const uint16_t* first = intern(&pool, hello);
+    EXPECT_NE(hello.data(), first);
+    EXPECT_EQ(hello, std::vector<uint16_t>(first, first + hello.size()));
+    EXPECT_EQ(1u, pool.size());
+
+    // The same text is stored only once.
+    const uint16_t* second = intern(&pool, utf8ToUtf16("hello"));
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(1u, pool.size());
+
+    const uint16_t* third = intern(&pool, world);
+    EXPECT_NE(first, third);
+    EXPECT_EQ(2u, pool.size());
+
+    pool.release(first);
+    EXPECT_EQ(2u, pool.size());
+    pool.release(second);
+    EXPECT_EQ(1u, pool.size());
+    pool.release(third);
+    EXPECT_EQ(0u, pool.size());
+}
+
+TEST(TextPoolTest, lengthTest) {
+    TextPool pool;
+    std::vector<std::vector<uint16_t>> texts;
+    texts.push_back(std::vector<uint16_t>());
+    for (uint32_t length = 1; length <= 200; length += 7) {
+        texts.push_back(std::vector<uint16_t>(length, 'a' + length % 26));
+    }
+    std::vector<const uint16_t*> interned;
+    for (const auto& text : texts) {
+        interned.push_back(intern(&pool, text));
+    }
+    // Enough texts to grow the hash table.
+    for (uint32_t i = 0; i < 1000; ++i) {
+        intern(&pool, utf8ToUtf16(std::to_string(i)));
+    }
+    EXPECT_EQ(texts.size() + 1000, pool.size());
+    for (size_t i = 0; i < texts.size(); ++i) {
+        EXPECT_EQ(interned[i], intern(&pool, texts[i]));
+        EXPECT_EQ(texts[i], std::vector<uint16_t>(interned[i], interned[i] + texts[i].size()));
+    }
+}
+
+}  // namespace minikin